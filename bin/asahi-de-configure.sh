@@ -4,13 +4,24 @@
 # Post-installation DE configuration
 # Enables the appropriate display manager and cleans up minimal image packages
 
+# Record each step in the setup phase trace
+step() {
+    [ -n "$STEP" ] && asahi-setup-trace.sh E "$STEP" configure
+    STEP="$1"
+    [ -n "$STEP" ] && asahi-setup-trace.sh B "$STEP" configure
+    return 0
+}
+
 # Disable the first-time setup service
+step disable-setup-service
 systemctl disable calamares-cage.service
 
 # Lock the root account
+step lock-root
 usermod -p '*' root
 
 # Read the display manager selection from the de-packages module
+step display-manager
 DM=$(cat /tmp/calamares-dm 2>/dev/null || echo "sddm")
 
 echo "Configuring display manager: $DM"
@@ -45,6 +56,7 @@ USER_NAME=$(cat /tmp/calamares-user 2>/dev/null || echo "")
 USER_HOME="/home/$USER_NAME"
 
 # Configure DE-specific settings
+step desktop-settings
 if [ "$DE" = "hyprland" ]; then
     echo "Configuring Hyprland..."
 
@@ -305,13 +317,20 @@ EOF
 fi
 
 # Clean up the temporary files
-rm -f /tmp/calamares-dm /tmp/calamares-de /tmp/calamares-user /tmp/calamares-packages
+step cleanup-temporary-files
+rm -f /tmp/calamares-dm /tmp/calamares-de /tmp/calamares-user /tmp/calamares-packages /tmp/calamares-dbsync /tmp/calamares-mirrorlist
+rm -rf /var/cache/calamares-prefetch
+# Setup is complete, a later run must not resume from this one
+rm -f /var/lib/calamares-asahi/journal.json /var/lib/calamares-asahi/journal.json.lock
 
 # Remove cage (no longer needed after setup)
+step remove-cage
 echo "Cleaning up unneeded packages..."
 pacman -Rs --noconfirm cage 2>/dev/null || true
 
 # Remove any orphaned dependencies
+step remove-orphans
 pacman -Qdtq | xargs -ro pacman -Rns --noconfirm 2>/dev/null || true
 
+step ""
 echo "DE configuration complete"
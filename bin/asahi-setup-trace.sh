@@ -0,0 +1,25 @@
+#!/usr/bin/sh
+# SPDX-License-Identifier: MIT
+#
+# Append one event to the setup phase trace
+#
+#   asahi-setup-trace.sh B|E|i <name> [category]
+#
+# B and E open and close a phase of the calling script, i marks a point
+# in time. The trace file is named by ASAHI_SETUP_TRACE, which
+# first-time-setup-cage.sh exports; without it this does nothing. See
+# calamares/modules/common/SetupTrace.h for the format.
+
+[ -n "$ASAHI_SETUP_TRACE" ] || exit 0
+[ -e "$ASAHI_SETUP_TRACE" ] || exit 0
+
+PHASE="$1"
+NAME="$2"
+CATEGORY="${3:-script}"
+SCOPE=""
+[ "$PHASE" = "i" ] && SCOPE=',"s":"p"'
+
+# The caller is the traced process, so B and E from one script pair up
+printf '{"name":"%s","cat":"%s","ph":"%s","ts":%s,"pid":%s,"tid":%s%s,"args":{"session":"%s"}},\n' \
+    "$NAME" "$CATEGORY" "$PHASE" "$(date +%s%6N)" "$PPID" "$PPID" "$SCOPE" \
+    "$ASAHI_SETUP_SESSION" >>"$ASAHI_SETUP_TRACE" 2>/dev/null || true
@@ -97,6 +97,17 @@ if [ -n "$xkblayout" ] && [ -n "$xkbmodel" ]; then
     localectl set-x11-keymap $xkblayout $xkbmodel $xkbvariant
 fi
 
+# Identify this setup run; the installer modules and scripts use it to
+# tell state written by this session from leftovers of an earlier one
+export ASAHI_SETUP_SESSION="$(cat /proc/sys/kernel/random/uuid)"
+
+# Phase trace of this run (see asahi-setup-trace.sh), kept after setup
+# so runs can be compared
+export ASAHI_SETUP_TRACE="/var/log/calamares-asahi/setup-trace-$ASAHI_SETUP_SESSION.json"
+mkdir -p "$(dirname "$ASAHI_SETUP_TRACE")"
+echo "[" >"$ASAHI_SETUP_TRACE" || unset ASAHI_SETUP_TRACE
+asahi-setup-trace.sh i setup-start session
+
 # Create a dummy home directory for Calamares
 export HOME="/run/user/0/calamares-home"
 rm -rf "$HOME"
@@ -131,4 +142,6 @@ export QT_QPA_PLATFORMTHEME=
 # Launch cage with Calamares
 # cage runs directly on DRM/KMS and sets up Wayland for its child
 # -s disables output scaling
+asahi-setup-trace.sh B cage session
 cage -s -- calamares -D8 -c /usr/share/calamares-asahi
+asahi-setup-trace.sh E cage session
@@ -0,0 +1,33 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Files of the background package database sync that networksetup runs
+ * once the network is up. de-packages reads them to skip its own
+ * refresh and to download from the same mirrors.
+ */
+
+#ifndef DATABASESYNC_H
+#define DATABASESYNC_H
+
+#include <QString>
+
+namespace DatabaseSync
+{
+
+/// Holds the ASAHI_SETUP_SESSION of the run whose sync succeeded
+inline QString
+stampFile()
+{
+    return QStringLiteral( "/tmp/calamares-dbsync" );
+}
+
+/// pacman.conf with the ranked mirrorlist, present once mirrors are ranked
+inline QString
+configFile()
+{
+    return QStringLiteral( "/tmp/calamares-dbsync-pacman.conf" );
+}
+
+}  // namespace DatabaseSync
+
+#endif  // DATABASESYNC_H
@@ -0,0 +1,49 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * The package repository on the install media, built by `make
+ * local-repo` and installed by `make install-local-repo` (see the
+ * top-level Makefile). The network page offers an offline install when
+ * it is present; de-packages installs from it in that case.
+ */
+
+#ifndef LOCALREPOSITORY_H
+#define LOCALREPOSITORY_H
+
+#include <QFileInfo>
+#include <QString>
+
+namespace LocalRepository
+{
+
+/// Directory holding the packages and the database, with a trailing slash
+inline QString
+path()
+{
+    return QStringLiteral( "/usr/share/calamares-asahi/local-repo/" );
+}
+
+/// Repository name, as passed to repo-add
+inline QString
+name()
+{
+    return QStringLiteral( "calamares-local" );
+}
+
+/// The repository's database
+inline QString
+database()
+{
+    return path() + name() + QStringLiteral( ".db" );
+}
+
+/// True if the media carries the repository
+inline bool
+exists()
+{
+    return QFileInfo::exists( database() );
+}
+
+}  // namespace LocalRepository
+
+#endif  // LOCALREPOSITORY_H
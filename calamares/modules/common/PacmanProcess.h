@@ -0,0 +1,51 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Whether a pacman process is running. A db.lck without one was left
+ * behind by a pacman that crashed or was killed, and nothing will ever
+ * remove it; waiting for it to go away would wait forever.
+ */
+
+#ifndef PACMANPROCESS_H
+#define PACMANPROCESS_H
+
+#include <QDir>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+namespace PacmanProcess
+{
+
+/// True if any process on the system is named pacman
+inline bool
+running()
+{
+    const auto entries = QDir( QStringLiteral( "/proc" ) ).entryList( QDir::Dirs | QDir::NoDotAndDotDot );
+    for ( const QString& pid : entries )
+    {
+        bool numeric = false;
+        pid.toInt( &numeric );
+        if ( !numeric )
+        {
+            continue;
+        }
+        QFile comm( QStringLiteral( "/proc/%1/comm" ).arg( pid ) );
+        if ( comm.open( QIODevice::ReadOnly ) && comm.readAll().trimmed() == "pacman" )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// True if @p lockFile exists and a pacman is around to release it
+inline bool
+holdsLock( const QString& lockFile )
+{
+    return QFile::exists( lockFile ) && running();
+}
+
+}  // namespace PacmanProcess
+
+#endif  // PACMANPROCESS_H
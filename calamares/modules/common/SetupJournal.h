@@ -0,0 +1,137 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Journal of a setup run that survives a crash or power loss. The
+ * networksetup page records the offline choice, de-packages the desktop
+ * answers once the user goes on, the resolved package plan and whether its
+ * install step committed; when calamares-cage.service runs again, those
+ * pages start from the answers and a committed install is not repeated.
+ * Steps of upstream Calamares modules are not journaled. Downloads need
+ * no entry: finished and partial files stay in the package caches, and
+ * the downloader's segment records say what of a partial file is good.
+ * asahi-de-configure.sh removes the journal once setup has completed.
+ *
+ * The journal is a JSON object of sections, each a map of keys to
+ * values; "globalStorage" holds GlobalStorage entries under their own
+ * keys, "completedSteps" maps exec steps to what they did.
+ */
+
+#ifndef SETUPJOURNAL_H
+#define SETUPJOURNAL_H
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QSaveFile>
+#include <QString>
+#include <QVariantMap>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace SetupJournal
+{
+
+inline QString
+path()
+{
+    return QStringLiteral( "/var/lib/calamares-asahi/journal.json" );
+}
+
+/// Holds the journal's lock file for the lifetime of the object
+class Lock
+{
+public:
+    Lock()
+    {
+        QDir().mkpath( QFileInfo( path() ).absolutePath() );
+        m_fd = ::open( QFile::encodeName( path() + QStringLiteral( ".lock" ) ).constData(),
+                       O_RDWR | O_CREAT | O_CLOEXEC,
+                       0644 );
+        if ( m_fd >= 0 )
+        {
+            ::flock( m_fd, LOCK_EX );
+        }
+    }
+    ~Lock()
+    {
+        if ( m_fd >= 0 )
+        {
+            ::close( m_fd );
+        }
+    }
+
+    Lock( const Lock& ) = delete;
+    Lock& operator=( const Lock& ) = delete;
+
+private:
+    int m_fd = -1;
+};
+
+/// The whole journal, empty if there is none or it cannot be read
+inline QVariantMap
+read()
+{
+    QFile file( path() );
+    if ( !file.open( QIODevice::ReadOnly ) )
+    {
+        return {};
+    }
+    return QJsonDocument::fromJson( file.readAll() ).object().toVariantMap();
+}
+
+inline QVariant
+value( const QString& section, const QString& key )
+{
+    return read().value( section ).toMap().value( key );
+}
+
+/** @brief Set @p key in @p section to @p value
+ *
+ * A null @p value removes the key. The file is only rewritten when
+ * something changed, so callers may record the same value repeatedly.
+ */
+inline bool
+insert( const QString& section, const QString& key, const QVariant& value )
+{
+    Lock lock;
+    QVariantMap journal = read();
+    QVariantMap entries = journal.value( section ).toMap();
+    // Compared as JSON, the form values have after a round trip
+    if ( value.isNull() ? !entries.contains( key )
+                        : QJsonValue::fromVariant( entries.value( key ) ) == QJsonValue::fromVariant( value ) )
+    {
+        return true;
+    }
+    if ( value.isNull() )
+    {
+        entries.remove( key );
+    }
+    else
+    {
+        entries.insert( key, value );
+    }
+    journal.insert( section, entries );
+
+    QSaveFile file( path() );
+    if ( !file.open( QIODevice::WriteOnly ) )
+    {
+        return false;
+    }
+    file.write( QJsonDocument( QJsonObject::fromVariantMap( journal ) ).toJson( QJsonDocument::Compact ) );
+    return file.commit();
+}
+
+inline void
+remove( const QString& section, const QString& key )
+{
+    insert( section, key, QVariant() );
+}
+
+}  // namespace SetupJournal
+
+#endif  // SETUPJOURNAL_H
@@ -0,0 +1,168 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Phase trace of a setup run, shared by the installer modules and
+ * bin/asahi-setup-trace.sh. Events go to the file named by
+ * ASAHI_SETUP_TRACE in Chrome's trace-event format: a "[" line, then
+ * one event object per line followed by a comma, which chrome://tracing
+ * and ui.perfetto.dev load as is. Every event carries the
+ * ASAHI_SETUP_SESSION ID so traces from many machines can be merged.
+ */
+
+#ifndef SETUPTRACE_H
+#define SETUPTRACE_H
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+
+#include <chrono>
+
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace SetupTrace
+{
+
+/// Wall-clock microseconds, the time base the shell helper uses as well
+inline qint64
+now()
+{
+    using namespace std::chrono;
+    return duration_cast< microseconds >( system_clock::now().time_since_epoch() ).count();
+}
+
+inline bool
+isEnabled()
+{
+    static const bool enabled = !qEnvironmentVariableIsEmpty( "ASAHI_SETUP_TRACE" );
+    return enabled;
+}
+
+inline void
+write( const QString& phase, const QString& name, const QString& category, qint64 ts, qint64 duration, const QVariantMap& args )
+{
+    if ( !isEnabled() )
+    {
+        return;
+    }
+    static const QByteArray path = qgetenv( "ASAHI_SETUP_TRACE" );
+    static const QString session = qEnvironmentVariable( "ASAHI_SETUP_SESSION" );
+
+    QVariantMap eventArgs = args;
+    eventArgs.insert( QStringLiteral( "session" ), session );
+
+    QJsonObject event { { QStringLiteral( "name" ), name },
+                        { QStringLiteral( "cat" ), category },
+                        { QStringLiteral( "ph" ), phase },
+                        { QStringLiteral( "ts" ), double( ts ) },
+                        { QStringLiteral( "pid" ), int( ::getpid() ) },
+                        { QStringLiteral( "tid" ), int( ::syscall( SYS_gettid ) ) },
+                        { QStringLiteral( "args" ), QJsonObject::fromVariantMap( eventArgs ) } };
+    if ( duration >= 0 )
+    {
+        event.insert( QStringLiteral( "dur" ), double( duration ) );
+    }
+    if ( phase == QLatin1String( "i" ) )
+    {
+        event.insert( QStringLiteral( "s" ), QStringLiteral( "p" ) );
+    }
+
+    // One write() with O_APPEND keeps lines from the scripts and from
+    // other threads from interleaving
+    const QByteArray line = QJsonDocument( event ).toJson( QJsonDocument::Compact ) + ",\n";
+    const int fd = ::open( path.constData(), O_WRONLY | O_APPEND | O_CLOEXEC );
+    if ( fd < 0 )
+    {
+        return;
+    }
+    const ssize_t written = ::write( fd, line.constData(), size_t( line.size() ) );
+    Q_UNUSED( written )
+    ::close( fd );
+}
+
+/// A point in time, e.g. a page becoming visible
+inline void
+instant( const QString& name, const QString& category, const QVariantMap& args = {} )
+{
+    write( QStringLiteral( "i" ), name, category, now(), -1, args );
+}
+
+/// A phase that started at @p start (from now()) and ends here
+inline void
+complete( const QString& name, const QString& category, qint64 start, const QVariantMap& args = {} )
+{
+    write( QStringLiteral( "X" ), name, category, start, now() - start, args );
+}
+
+/**
+ * @brief Records the calling thread's event loop standing still
+ *
+ * A timer ticks every few milliseconds; each tick that comes at least
+ * @p thresholdMs late is written as an "event-loop-stall" phase covering
+ * the time the loop did not run. Meant for the GUI thread, where those
+ * are the moments the installer froze. The ticks wake the installer 50
+ * times a second, so this only runs when ASAHI_SETUP_TRACE_STALLS is set
+ * as well as the trace itself; real installs leave it unset.
+ */
+inline void
+watchEventLoop( QObject* context, int thresholdMs = 100 )
+{
+    if ( !isEnabled() || qEnvironmentVariableIsEmpty( "ASAHI_SETUP_TRACE_STALLS" ) )
+    {
+        return;
+    }
+    constexpr int intervalMs = 20;
+    auto* timer = new QTimer( context );
+    timer->setTimerType( Qt::PreciseTimer );
+    QObject::connect( timer,
+                      &QTimer::timeout,
+                      context,
+                      [ last = now(), thresholdMs ]() mutable
+                      {
+                          const qint64 tick = now();
+                          const qint64 late = tick - last - intervalMs * 1000;
+                          if ( late >= qint64( thresholdMs ) * 1000 )
+                          {
+                              write( QStringLiteral( "X" ),
+                                     QStringLiteral( "event-loop-stall" ),
+                                     QStringLiteral( "ui" ),
+                                     last + intervalMs * 1000,
+                                     late,
+                                     {} );
+                          }
+                          last = tick;
+                      } );
+    timer->start( intervalMs );
+}
+
+/// Traces the enclosing scope as one phase
+class Span
+{
+public:
+    Span( const QString& name, const QString& category )
+        : m_name( name )
+        , m_category( category )
+        , m_start( now() )
+    {
+    }
+    ~Span() { complete( m_name, m_category, m_start, m_args ); }
+
+    Span( const Span& ) = delete;
+    Span& operator=( const Span& ) = delete;
+
+    void setArg( const QString& key, const QVariant& value ) { m_args.insert( key, value ); }
+
+private:
+    QString m_name;
+    QString m_category;
+    qint64 m_start;
+    QVariantMap m_args;
+};
+
+}  // namespace SetupTrace
+
+#endif  // SETUPTRACE_H
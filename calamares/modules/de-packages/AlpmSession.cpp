@@ -0,0 +1,349 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "AlpmSession.h"
+
+#include "PackagePrefetcher.h"
+
+#include "utils/Logger.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QUrl>
+
+#include <cstdlib>
+
+AlpmSession::~AlpmSession()
+{
+    if ( m_handle )
+    {
+        alpm_release( m_handle );
+    }
+}
+
+bool
+AlpmSession::initialize( const PacmanConfig& config, const QStringList& extraCacheDirs )
+{
+    if ( m_handle )
+    {
+        alpm_release( m_handle );
+        m_handle = nullptr;
+    }
+    m_config = config;
+
+    alpm_errno_t err = ALPM_ERR_OK;
+    m_handle = alpm_initialize( config.rootDir.toLocal8Bit().constData(), config.dbPath.toLocal8Bit().constData(), &err );
+    if ( !m_handle )
+    {
+        m_initError = QString::fromLocal8Bit( alpm_strerror( err ) );
+        cWarning() << "de-packages: failed to initialize libalpm:" << m_initError;
+        return false;
+    }
+
+    alpm_option_set_gpgdir( m_handle, config.gpgDir.toLocal8Bit().constData() );
+    alpm_option_set_logfile( m_handle, config.logFile.toLocal8Bit().constData() );
+    for ( const QString& dir : config.cacheDirs + extraCacheDirs )
+    {
+        alpm_option_add_cachedir( m_handle, dir.toLocal8Bit().constData() );
+    }
+    for ( const QString& dir : config.hookDirs )
+    {
+        alpm_option_add_hookdir( m_handle, dir.toLocal8Bit().constData() );
+    }
+    for ( const QString& arch : config.architectures )
+    {
+        alpm_option_add_architecture( m_handle, arch.toLocal8Bit().constData() );
+    }
+    for ( const QString& pkg : config.ignorePackages )
+    {
+        alpm_option_add_ignorepkg( m_handle, pkg.toLocal8Bit().constData() );
+    }
+    for ( const QString& group : config.ignoreGroups )
+    {
+        alpm_option_add_ignoregroup( m_handle, group.toLocal8Bit().constData() );
+    }
+    for ( const QString& path : config.noUpgrade )
+    {
+        alpm_option_add_noupgrade( m_handle, path.toLocal8Bit().constData() );
+    }
+    for ( const QString& path : config.noExtract )
+    {
+        alpm_option_add_noextract( m_handle, path.toLocal8Bit().constData() );
+    }
+    alpm_option_set_default_siglevel( m_handle, config.sigLevel );
+    alpm_option_set_parallel_downloads( m_handle, static_cast< unsigned int >( config.parallelDownloads ) );
+    alpm_option_set_checkspace( m_handle, config.checkSpace ? 1 : 0 );
+    alpm_option_set_disable_dl_timeout( m_handle, 1 );
+
+    for ( const PacmanRepository& repo : config.repositories )
+    {
+        alpm_db_t* db = alpm_register_syncdb( m_handle, repo.name.toLocal8Bit().constData(), repo.sigLevel );
+        if ( !db )
+        {
+            cWarning() << "de-packages: could not register repository" << repo.name << errorString();
+            continue;
+        }
+        alpm_db_set_usage( db, ALPM_DB_USAGE_ALL );
+        for ( const QString& server : repo.servers )
+        {
+            alpm_db_add_server( db, server.toLocal8Bit().constData() );
+        }
+    }
+
+    return true;
+}
+
+bool
+AlpmSession::initializeForInstall( bool offline )
+{
+    PacmanConfig config = PacmanConfig::load();
+    QStringList cacheDirs { PackagePrefetcher::cacheDirectory() };
+    if ( PacmanConfig::hasLocalRepository() )
+    {
+        cacheDirs << PacmanConfig::localRepositoryPath();
+        if ( offline )
+        {
+            config.repositories = { PacmanConfig::localRepository() };
+        }
+    }
+    else if ( offline )
+    {
+        cWarning() << "de-packages: offline install requested, but there is no local repository";
+    }
+
+    if ( !initialize( config, cacheDirs ) )
+    {
+        return false;
+    }
+    if ( offline )
+    {
+        seedLocalDatabase();
+    }
+    return true;
+}
+
+void
+AlpmSession::seedLocalDatabase() const
+{
+    // Offline there is no sync step, so copy the index into place directly
+    const PacmanRepository repo = PacmanConfig::localRepository();
+    const QFileInfo source( PacmanConfig::localRepositoryPath() + repo.name + QStringLiteral( ".db" ) );
+    const QFileInfo target( m_config.dbPath + QStringLiteral( "sync/" ) + repo.name + QStringLiteral( ".db" ) );
+    if ( target.exists() && target.size() == source.size() && target.lastModified() >= source.lastModified() )
+    {
+        return;
+    }
+
+    // The resolver, the name index and the install job all get here at
+    // about the same time, so the copy is renamed into place whole; the
+    // others see either the old database or the new one
+    QFile in( source.absoluteFilePath() );
+    QSaveFile out( target.filePath() );
+    if ( !in.open( QIODevice::ReadOnly ) || !out.open( QIODevice::WriteOnly ) )
+    {
+        cWarning() << "de-packages: could not copy the local repository database to" << target.filePath();
+        return;
+    }
+    out.write( in.readAll() );
+    if ( !out.commit() )
+    {
+        cWarning() << "de-packages: could not copy the local repository database to" << target.filePath()
+                   << out.errorString();
+    }
+}
+
+bool
+AlpmSession::updateDatabases( bool force )
+{
+    if ( !m_handle )
+    {
+        return false;
+    }
+    return alpm_db_update( m_handle, alpm_get_syncdbs( m_handle ), force ? 1 : 0 ) >= 0;
+}
+
+void
+AlpmSession::dropMirrors( const QSet< QString >& hosts )
+{
+    if ( !m_handle || hosts.isEmpty() )
+    {
+        return;
+    }
+
+    for ( alpm_list_t* i = alpm_get_syncdbs( m_handle ); i; i = alpm_list_next( i ) )
+    {
+        auto* db = static_cast< alpm_db_t* >( i->data );
+        QStringList bad;
+        int servers = 0;
+        for ( alpm_list_t* s = alpm_db_get_servers( db ); s; s = alpm_list_next( s ) )
+        {
+            const QString server = QString::fromLocal8Bit( static_cast< const char* >( s->data ) );
+            ++servers;
+            if ( hosts.contains( QUrl( server ).host() ) )
+            {
+                bad << server;
+            }
+        }
+        if ( bad.size() == servers )
+        {
+            continue;
+        }
+        for ( const QString& server : bad )
+        {
+            alpm_db_remove_server( db, server.toLocal8Bit().constData() );
+        }
+    }
+}
+
+QVector< alpm_pkg_t* >
+AlpmSession::findTargets( const QStringList& names, QStringList* missing ) const
+{
+    QVector< alpm_pkg_t* > targets;
+    if ( !m_handle )
+    {
+        if ( missing )
+        {
+            *missing = names;
+        }
+        return targets;
+    }
+
+    alpm_list_t* syncdbs = alpm_get_syncdbs( m_handle );
+    QSet< alpm_pkg_t* > seen;
+    for ( const QString& name : names )
+    {
+        const QByteArray target = name.toLocal8Bit();
+        alpm_pkg_t* pkg = alpm_find_dbs_satisfier( m_handle, syncdbs, target.constData() );
+        if ( pkg )
+        {
+            if ( !seen.contains( pkg ) )
+            {
+                seen.insert( pkg );
+                targets.append( pkg );
+            }
+            continue;
+        }
+
+        alpm_list_t* group = alpm_find_group_pkgs( syncdbs, target.constData() );
+        if ( !group )
+        {
+            if ( missing )
+            {
+                missing->append( name );
+            }
+            continue;
+        }
+        for ( alpm_list_t* i = group; i; i = alpm_list_next( i ) )
+        {
+            auto* member = static_cast< alpm_pkg_t* >( i->data );
+            if ( !seen.contains( member ) )
+            {
+                seen.insert( member );
+                targets.append( member );
+            }
+        }
+        alpm_list_free( group );
+    }
+    return targets;
+}
+
+QString
+AlpmSession::errorString() const
+{
+    if ( !m_handle )
+    {
+        return m_initError;
+    }
+    return QString::fromLocal8Bit( alpm_strerror( alpm_errno( m_handle ) ) );
+}
+
+alpm_errno_t
+AlpmSession::lastError() const
+{
+    return m_handle ? alpm_errno( m_handle ) : ALPM_ERR_HANDLE_NULL;
+}
+
+QString
+AlpmSession::databaseFingerprint() const
+{
+    // Good enough to notice a sync between resolving and installing
+    QStringList parts;
+    const QDir syncDir( m_config.dbPath + QStringLiteral( "sync" ) );
+    const auto entries = syncDir.entryInfoList( QStringList { QStringLiteral( "*.db" ) }, QDir::Files, QDir::Name );
+    for ( const QFileInfo& entry : entries )
+    {
+        parts << QStringLiteral( "%1:%2:%3" )
+                     .arg( entry.fileName() )
+                     .arg( entry.size() )
+                     .arg( entry.lastModified().toSecsSinceEpoch() );
+    }
+    return parts.join( QLatin1Char( ';' ) );
+}
+
+QString
+AlpmSession::prepareErrorDetails( alpm_errno_t err, alpm_list_t* data )
+{
+    QStringList details;
+    for ( alpm_list_t* i = data; i; i = alpm_list_next( i ) )
+    {
+        if ( err == ALPM_ERR_UNSATISFIED_DEPS )
+        {
+            auto* miss = static_cast< alpm_depmissing_t* >( i->data );
+            char* dep = alpm_dep_compute_string( miss->depend );
+            details << QStringLiteral( "%1: requires %2" )
+                           .arg( QString::fromLocal8Bit( miss->target ), QString::fromLocal8Bit( dep ) );
+            free( dep );
+            alpm_depmissing_free( miss );
+        }
+        else if ( err == ALPM_ERR_CONFLICTING_DEPS )
+        {
+            auto* conflict = static_cast< alpm_conflict_t* >( i->data );
+            details << QStringLiteral( "%1 conflicts with %2" )
+                           .arg( QString::fromLocal8Bit( alpm_pkg_get_name( conflict->package1 ) ),
+                                 QString::fromLocal8Bit( alpm_pkg_get_name( conflict->package2 ) ) );
+            alpm_conflict_free( conflict );
+        }
+    }
+    alpm_list_free( data );
+    return details.join( QLatin1Char( '\n' ) );
+}
+
+QString
+AlpmSession::commitErrorDetails( alpm_errno_t err, alpm_list_t* data )
+{
+    QStringList details;
+    for ( alpm_list_t* i = data; i; i = alpm_list_next( i ) )
+    {
+        if ( err == ALPM_ERR_FILE_CONFLICTS )
+        {
+            auto* conflict = static_cast< alpm_fileconflict_t* >( i->data );
+            if ( conflict->type == ALPM_FILECONFLICT_TARGET )
+            {
+                details << QStringLiteral( "%1 exists in both %2 and %3" )
+                               .arg( QString::fromLocal8Bit( conflict->file ),
+                                     QString::fromLocal8Bit( conflict->target ),
+                                     QString::fromLocal8Bit( conflict->ctarget ) );
+            }
+            else
+            {
+                details << QStringLiteral( "%1: %2 exists in filesystem" )
+                               .arg( QString::fromLocal8Bit( conflict->target ),
+                                     QString::fromLocal8Bit( conflict->file ) );
+            }
+            alpm_fileconflict_free( conflict );
+        }
+        else if ( err == ALPM_ERR_PKG_INVALID || err == ALPM_ERR_PKG_INVALID_CHECKSUM
+                  || err == ALPM_ERR_PKG_INVALID_SIG )
+        {
+            auto* file = static_cast< char* >( i->data );
+            details << QStringLiteral( "%1 is invalid or corrupted" ).arg( QString::fromLocal8Bit( file ) );
+            free( file );
+        }
+    }
+    alpm_list_free( data );
+    return details.join( QLatin1Char( '\n' ) );
+}
@@ -0,0 +1,91 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Owns a libalpm handle configured from pacman.conf, so the sync
+ * databases are loaded once and reused for every transaction.
+ */
+
+#ifndef ALPMSESSION_H
+#define ALPMSESSION_H
+
+#include "PacmanConfig.h"
+
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <alpm.h>
+
+class AlpmSession
+{
+public:
+    AlpmSession() = default;
+    ~AlpmSession();
+
+    AlpmSession( const AlpmSession& ) = delete;
+    AlpmSession& operator=( const AlpmSession& ) = delete;
+
+    /** @brief Create the handle and register every sync repository
+     *
+     * @p extraCacheDirs are searched after the configured CacheDir
+     * entries; downloads always go to the first writable directory.
+     */
+    bool initialize( const PacmanConfig& config, const QStringList& extraCacheDirs = QStringList() );
+
+    /** @brief Set up the session the installer transactions use
+     *
+     * Reads /etc/pacman.conf and adds the prefetch cache and the local
+     * repository on the install media as cache directories, so packages
+     * come from there whenever the remote databases ask for the same
+     * version. With @p offline, the local repository replaces every
+     * configured one.
+     */
+    bool initializeForInstall( bool offline );
+
+    alpm_handle_t* handle() const { return m_handle; }
+    const PacmanConfig& config() const { return m_config; }
+    bool isValid() const { return m_handle != nullptr; }
+
+    /// Refresh the sync databases; @p force ignores up-to-date checks.
+    bool updateDatabases( bool force );
+
+    /** @brief Stop using the servers on @p hosts
+     *
+     * A repository keeps its servers if all of them would be dropped.
+     */
+    void dropMirrors( const QSet< QString >& hosts );
+
+    /** @brief Look up install targets in the sync databases
+     *
+     * Each name may be a package, something a package provides, or a
+     * group (which expands to all of its members). Names that match
+     * nothing are appended to @p missing.
+     */
+    QVector< alpm_pkg_t* > findTargets( const QStringList& names, QStringList* missing ) const;
+
+    /** @brief Identifies the current state of the sync databases
+     *
+     * Two equal fingerprints mean nothing was synced in between, so a
+     * transaction resolved against one is still valid for the other.
+     */
+    QString databaseFingerprint() const;
+
+    /// Describe and free the list alpm_trans_prepare() returned.
+    static QString prepareErrorDetails( alpm_errno_t err, alpm_list_t* data );
+    /// Describe and free the list alpm_trans_commit() returned.
+    static QString commitErrorDetails( alpm_errno_t err, alpm_list_t* data );
+
+    /// Human-readable description of the last libalpm error.
+    QString errorString() const;
+    alpm_errno_t lastError() const;
+
+private:
+    void seedLocalDatabase() const;
+
+    alpm_handle_t* m_handle = nullptr;
+    PacmanConfig m_config;
+    QString m_initError;
+};
+
+#endif  // ALPMSESSION_H
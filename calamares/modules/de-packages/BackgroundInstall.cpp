@@ -0,0 +1,98 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "BackgroundInstall.h"
+
+#include "PackageInstallJob.h"
+#include "SetupTrace.h"
+
+#include "utils/Logger.h"
+
+#include <QMutexLocker>
+#include <QThread>
+
+BackgroundInstall::~BackgroundInstall()
+{
+    if ( m_thread )
+    {
+        m_thread->wait();
+        delete m_thread;
+    }
+}
+
+void
+BackgroundInstall::start( const QStringList& targets )
+{
+    if ( m_thread )
+    {
+        return;
+    }
+
+    cDebug() << "de-packages: starting the installation ahead of the exec phase";
+    SetupTrace::instant( QStringLiteral( "install-overlapped" ), QStringLiteral( "install" ) );
+    m_targets = targets;
+    m_job = Calamares::job_ptr( new PackageInstallJob() );
+    m_outcome = std::make_shared< Outcome >();
+
+    // The job object stays on this thread, as it does for the JobQueue
+    m_thread = QThread::create(
+        [job = m_job, outcome = m_outcome]()
+        {
+            const Calamares::JobResult result = job->exec();
+            QMutexLocker locker( &outcome->mutex );
+            outcome->ok = bool( result );
+            outcome->message = result.message();
+            outcome->details = result.details();
+            outcome->done = true;
+            outcome->finished.wakeAll();
+        } );
+    m_thread->start();
+}
+
+Calamares::job_ptr
+BackgroundInstall::job() const
+{
+    return Calamares::job_ptr( new BackgroundInstallJob( m_job, m_outcome ) );
+}
+
+BackgroundInstallJob::BackgroundInstallJob( Calamares::job_ptr running,
+                                            std::shared_ptr< BackgroundInstall::Outcome > outcome )
+    : m_running( std::move( running ) )
+    , m_outcome( std::move( outcome ) )
+{
+}
+
+QString
+BackgroundInstallJob::prettyName() const
+{
+    return m_running->prettyName();
+}
+
+QString
+BackgroundInstallJob::prettyStatusMessage() const
+{
+    return m_running->prettyStatusMessage();
+}
+
+Calamares::JobResult
+BackgroundInstallJob::exec()
+{
+    SetupTrace::Span trace( QStringLiteral( "install-wait" ), QStringLiteral( "install" ) );
+    // Progress from here on shows up on the exec page as usual
+    connect( m_running.data(), &Calamares::Job::progress, this, &Calamares::Job::progress, Qt::DirectConnection );
+
+    QMutexLocker locker( &m_outcome->mutex );
+    trace.setArg( QStringLiteral( "finishedEarly" ), m_outcome->done );
+    while ( !m_outcome->done )
+    {
+        m_outcome->finished.wait( &m_outcome->mutex );
+    }
+    disconnect( m_running.data(), nullptr, this, nullptr );
+
+    if ( !m_outcome->ok )
+    {
+        return Calamares::JobResult::error( m_outcome->message, m_outcome->details );
+    }
+    return Calamares::JobResult::ok();
+}
@@ -0,0 +1,79 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Runs the package transaction while the pages after de-packages are
+ * still being filled in, and hands its result to the exec phase.
+ */
+
+#ifndef BACKGROUNDINSTALL_H
+#define BACKGROUNDINSTALL_H
+
+#include "Job.h"
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QWaitCondition>
+
+#include <memory>
+
+class QThread;
+
+class BackgroundInstall
+{
+public:
+    BackgroundInstall() = default;
+    /// Waits for the transaction; interrupting it would leave a broken system
+    ~BackgroundInstall();
+
+    BackgroundInstall( const BackgroundInstall& ) = delete;
+    BackgroundInstall& operator=( const BackgroundInstall& ) = delete;
+
+    /** @brief Start installing the packageOperations now in GlobalStorage
+     *
+     * Only the first call starts anything; @p targets is what those
+     * operations install.
+     */
+    void start( const QStringList& targets );
+    bool isStarted() const { return m_thread != nullptr; }
+    /// What the running transaction installs
+    QStringList targets() const { return m_targets; }
+
+    /// The exec phase job, which waits for the transaction to finish
+    Calamares::job_ptr job() const;
+
+    struct Outcome
+    {
+        QMutex mutex;
+        QWaitCondition finished;
+        bool done = false;
+        bool ok = false;
+        QString message;
+        QString details;
+    };
+
+private:
+    Calamares::job_ptr m_job;
+    std::shared_ptr< Outcome > m_outcome;
+    QThread* m_thread = nullptr;
+    QStringList m_targets;
+};
+
+class BackgroundInstallJob : public Calamares::Job
+{
+    Q_OBJECT
+
+public:
+    BackgroundInstallJob( Calamares::job_ptr running, std::shared_ptr< BackgroundInstall::Outcome > outcome );
+
+    QString prettyName() const override;
+    QString prettyStatusMessage() const override;
+
+    Calamares::JobResult exec() override;
+
+private:
+    Calamares::job_ptr m_running;
+    std::shared_ptr< BackgroundInstall::Outcome > m_outcome;
+};
+
+#endif  // BACKGROUNDINSTALL_H
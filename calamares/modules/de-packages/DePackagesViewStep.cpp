@@ -3,32 +3,38 @@
  */
 
 #include "DePackagesViewStep.h"
+#include "BackgroundInstall.h"
+#include "DesktopDelegate.h"
+#include "DesktopListModel.h"
+#include "DesktopResolver.h"
+#include "PackageInstallJob.h"
+#include "PackageListEdit.h"
+#include "PackageNameIndex.h"
+#include "PackagePrefetcher.h"
+#include "SelectionWriter.h"
+#include "SetupJournal.h"
+#include "SetupTrace.h"
+#include "ThumbnailLoader.h"
 
 #include "GlobalStorage.h"
 #include "JobQueue.h"
+#include "ViewManager.h"
 #include "Branding.h"
 #include "utils/Logger.h"
 
 #include <algorithm>
 
-#include <QAbstractButton>
-#include <QButtonGroup>
-#include <QFile>
 #include <QFont>
 #include <QHash>
 #include <QLabel>
-#include <QRadioButton>
+#include <QListView>
+#include <QLocale>
 #include <QPixmap>
-#include <QScrollArea>
-#include <QSignalBlocker>
-#include <QTextStream>
 #include <QStringList>
+#include <QTimer>
 #include <QVariantList>
 #include <QVariantMap>
 #include <QVBoxLayout>
-#include <QFrame>
-#include <QHBoxLayout>
-#include <QSizePolicy>
 #include <QPalette>
 #include <QFileInfo>
 #include <QPainter>
@@ -166,15 +172,118 @@ QString formatPackages( const QStringList& packages )
 {
     return packages.join( QStringLiteral( ", " ) );
 }
+
+constexpr qreal s_mebibyte = 1024.0 * 1024.0;
+constexpr qreal s_defaultDownloadRate = 2.0;
+constexpr qreal s_defaultInstallRate = 40.0;
+
+const QString s_databasesSyncedKey = QStringLiteral( "packageDatabasesSynced" );
+const QString s_mirrorThroughputKey = QStringLiteral( "mirrorThroughput" );
+const QString s_offlineKey = QStringLiteral( "offlineInstall" );
+const QString s_planKey = QStringLiteral( "packagePlan" );
+const QString s_selectionKey = QStringLiteral( "packagechooser_packagechooser" );
+
+/// Screenshots are fit into this, in device-independent pixels
+const QSize s_previewSize( 140, 100 );
+
+const QRegularExpression s_whitespace( QStringLiteral( "\\s+" ) );
+
+/// Typing in the custom editor only commits once it pauses this long
+constexpr int s_commitDelayMs = 400;
+
+const QColor s_errorColor( 0xc6, 0x28, 0x28 );
+const QColor s_successColor( 0x2e, 0x7d, 0x32 );
+
+// Journal sections; the custom entries are not in GlobalStorage
+const QString s_journalGlobalStorage = QStringLiteral( "globalStorage" );
+const QString s_journalCustom = QStringLiteral( "customDesktop" );
 }  // namespace
 
 CALAMARES_PLUGIN_FACTORY_DEFINITION( DePackagesViewStepFactory, registerPlugin< DePackagesViewStep >(); )
 
 DePackagesViewStep::DePackagesViewStep( QObject* parent )
     : Calamares::ViewStep( parent )
+    , m_prefetcher( new PackagePrefetcher( this ) )
+    , m_resolver( new DesktopResolver( this ) )
+    , m_thumbnails( new ThumbnailLoader( this ) )
+    , m_nameIndex( new PackageNameIndex( this ) )
+    , m_choiceModel( new DesktopListModel( this ) )
+    , m_choiceDelegate(
+          new DesktopDelegate( [this]( const QModelIndex& index, qreal dpr ) { return previewPixmap( index, dpr ); },
+                               this ) )
+    , m_commitTimer( new QTimer( this ) )
+    , m_writer( std::make_unique< SelectionWriter >() )
+    , m_backgroundInstall( std::make_unique< BackgroundInstall >() )
+    , m_downloadRate( s_defaultDownloadRate * s_mebibyte )
+    , m_installRate( s_defaultInstallRate * s_mebibyte )
 {
+    SetupTrace::instant( QStringLiteral( "de-packages-loaded" ), QStringLiteral( "module" ) );
     setCanProceed( false );
     setStatusMessage( tr( "Select a desktop to continue." ), true );
+
+    m_commitTimer->setSingleShot( true );
+    m_commitTimer->setInterval( s_commitDelayMs );
+    connect( m_commitTimer, &QTimer::timeout, this, &DePackagesViewStep::commitSelection );
+
+    connect( m_nameIndex,
+             &PackageNameIndex::ready,
+             this,
+             [this]()
+             {
+                 // Names typed before the index was there are checked now
+                 if ( m_lastSelection == QStringLiteral( "custom" ) )
+                 {
+                     applySelection( m_lastSelection, true );
+                 }
+             } );
+
+    connect( m_resolver,
+             &DesktopResolver::resolved,
+             this,
+             [this]( const QString& id )
+             {
+                 updateSizeLabel( id );
+                 if ( id == m_lastSelection )
+                 {
+                     // Re-apply in case the old plan had made it unavailable
+                     if ( m_statusIsError )
+                     {
+                         applySelection( id );
+                     }
+                     else
+                     {
+                         publishPlan();
+                     }
+                 }
+             } );
+
+    connect( m_thumbnails,
+             &ThumbnailLoader::loaded,
+             this,
+             [this]( const QStringList& candidates )
+             {
+                 // Only the cards showing this screenshot need repainting
+                 for ( const DesktopChoice& choice : m_choiceModel->choices() )
+                 {
+                     if ( !choice.screenshot.isEmpty() && candidates.contains( choice.screenshot ) )
+                     {
+                         m_choiceModel->previewChanged( choice.id );
+                     }
+                 }
+             } );
+
+    auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+    if ( gs )
+    {
+        // Start from the answer given before an interrupted earlier run
+        const QString journaled = SetupJournal::value( s_journalGlobalStorage, s_selectionKey ).toString();
+        if ( !journaled.isEmpty() && !gs->contains( s_selectionKey ) )
+        {
+            cDebug() << "de-packages: restoring selection" << journaled << "from the setup journal";
+            gs->insert( s_selectionKey, journaled );
+        }
+        connect( gs, &Calamares::GlobalStorage::changed, this, &DePackagesViewStep::onGlobalStorageChanged );
+    }
 }
 
 DePackagesViewStep::~DePackagesViewStep()
@@ -231,7 +340,16 @@ DePackagesViewStep::isAtEnd() const
 Calamares::JobList
 DePackagesViewStep::jobs() const
 {
-    return Calamares::JobList();
+    Calamares::JobList list;
+    if ( m_backgroundInstall->isStarted() )
+    {
+        list.append( m_backgroundInstall->job() );
+    }
+    else
+    {
+        list.append( Calamares::job_ptr( new PackageInstallJob() ) );
+    }
+    return list;
 }
 
 void
@@ -258,13 +376,102 @@ DePackagesViewStep::setConfigurationMap( const QVariantMap& configurationMap )
         choice.screenshot = map.value( QStringLiteral( "screenshot" ) ).toString();
         m_choices.append( choice );
     }
+
+    m_prefetchEnabled = configurationMap.value( QStringLiteral( "prefetch" ), true ).toBool();
+    m_overlapInstall = configurationMap.value( QStringLiteral( "overlapInstall" ), false ).toBool();
+
+    const qreal downloadRate
+        = configurationMap.value( QStringLiteral( "estimateDownloadRate" ), s_defaultDownloadRate ).toDouble();
+    const qreal installRate
+        = configurationMap.value( QStringLiteral( "estimateInstallRate" ), s_defaultInstallRate ).toDouble();
+    m_downloadRate = ( downloadRate > 0 ? downloadRate : s_defaultDownloadRate ) * s_mebibyte;
+    m_installRate = ( installRate > 0 ? installRate : s_defaultInstallRate ) * s_mebibyte;
 }
 
 void
 DePackagesViewStep::onActivate()
 {
+    m_activatedAt = SetupTrace::now();
     ensureWidget();
     updateSelection();
+
+    if ( m_backgroundInstall->isStarted() )
+    {
+        // Back from a later page; the transaction cannot be taken back
+        m_choiceView->setEnabled( false );
+        m_customWidget->setEnabled( false );
+        setStatusMessage( tr( "Installation of %1 has already started: %2." )
+                              .arg( m_lastSelection, formatPackages( m_backgroundInstall->targets() ) ),
+                          false );
+    }
+}
+
+void
+DePackagesViewStep::onLeave()
+{
+    auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+    if ( m_activatedAt > 0 )
+    {
+        SetupTrace::complete( QStringLiteral( "page-de-packages" ),
+                              QStringLiteral( "page" ),
+                              m_activatedAt,
+                              { { QStringLiteral( "selection" ), gs ? gs->value( s_selectionKey ) : QVariant() } } );
+    }
+    m_activatedAt = 0;
+
+    // The jobs read what the last keystrokes in the custom editor set
+    if ( m_commitTimer->isActive() )
+    {
+        commitSelection();
+    }
+    m_writer->flush();
+
+    // onLeave() does not say which way the user went; the view manager
+    // knows once the next page is active
+    QMetaObject::invokeMethod( this, &DePackagesViewStep::journalAnswers, Qt::QueuedConnection );
+    if ( m_overlapInstall && m_canProceed )
+    {
+        QMetaObject::invokeMethod( this, &DePackagesViewStep::startOverlappedInstall, Qt::QueuedConnection );
+    }
+}
+
+void
+DePackagesViewStep::journalAnswers()
+{
+    // Next confirms the answers; Back leaves the journal as it was
+    auto* manager = Calamares::ViewManager::instance();
+    if ( !manager || manager->currentStepIndex() <= manager->viewSteps().indexOf( this ) )
+    {
+        return;
+    }
+
+    auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+    if ( gs && gs->contains( s_selectionKey ) )
+    {
+        SetupJournal::insert( s_journalGlobalStorage, s_selectionKey, gs->value( s_selectionKey ) );
+    }
+    if ( m_customPackagesEdit && m_customDmEdit )
+    {
+        SetupJournal::insert(
+            s_journalCustom, QStringLiteral( "packages" ), m_customPackagesEdit->toPlainText().trimmed() );
+        SetupJournal::insert( s_journalCustom, QStringLiteral( "displayManager" ), m_customDmEdit->text().trimmed() );
+    }
+}
+
+void
+DePackagesViewStep::startOverlappedInstall()
+{
+    auto* manager = Calamares::ViewManager::instance();
+    if ( !manager || m_backgroundInstall->isStarted() || !m_canProceed
+         || manager->currentStepIndex() <= manager->viewSteps().indexOf( this ) )
+    {
+        return;
+    }
+
+    // The transaction fetches whatever the prefetcher has not; two
+    // pacman instances would only wait on each other's lock
+    m_prefetcher->cancel();
+    m_backgroundInstall->start( m_selectedPackages );
 }
 
 void
@@ -316,6 +523,7 @@ DePackagesViewStep::ensureWidget()
 
     m_statusLabel = new QLabel( tr( "Waiting for a desktop selection ..." ), page );
     m_statusLabel->setWordWrap( true );
+    m_statusLabel->setPalette( statusPalette( m_statusLabel->palette(), m_statusIsError ) );
     layout->addWidget( m_statusLabel );
 
     layout->addSpacing( 15 );
@@ -345,145 +553,103 @@ DePackagesViewStep::ensureWidget()
     {
         setStatusMessage( m_statusMessage, m_statusIsError );
     }
+
+    resolveDesktops();
 }
 
 void
 DePackagesViewStep::buildChoicesUi( QWidget* page, QVBoxLayout* layout )
 {
-    auto choices = availableChoices();
-
-    m_choiceGroup = new QButtonGroup( page );
-    m_choiceGroup->setExclusive( true );
-    m_optionWidgets.clear();
-
-    auto* scrollArea = new QScrollArea( page );
-    scrollArea->setWidgetResizable( true );
-
-    auto* container = new QWidget( scrollArea );
-    auto* containerLayout = new QVBoxLayout( container );
-    containerLayout->setSpacing( 10 );
-    containerLayout->setContentsMargins( 0, 0, 0, 0 );
-
-    int addedChoices = 0;
-
-    for ( const DesktopChoice& choice : choices )
+    QVector< DesktopChoice > choices;
+    for ( const DesktopChoice& choice : availableChoices() )
     {
-        const bool isCustom = ( choice.id == QStringLiteral( "custom" ) );
-        if ( !isCustom && !s_desktops.contains( choice.id ) )
+        if ( choice.id != QStringLiteral( "custom" ) && !s_desktops.contains( choice.id ) )
         {
             cWarning() << "de-packages: configuration references unknown desktop" << choice.id;
             continue;
         }
-
-        ++addedChoices;
-
-        auto* frame = new QFrame( container );
-        frame->setFrameShape( QFrame::StyledPanel );
-        frame->setFrameShadow( QFrame::Plain );
-        frame->setStyleSheet( frameStyleSheet( false ) );
-
-        auto* rowLayout = new QHBoxLayout( frame );
-        rowLayout->setContentsMargins( 14, 12, 14, 12 );
-        rowLayout->setSpacing( 14 );
-
-        QPixmap pixmap = loadScreenshot( choice.screenshot );
-        if ( pixmap.isNull() )
-        {
-            pixmap = placeholderPixmap( choice.name );
-        }
-
-        if ( !pixmap.isNull() )
-        {
-            auto* preview = new QLabel( frame );
-            preview->setPixmap( pixmap.scaled( 140, 100, Qt::KeepAspectRatio, Qt::SmoothTransformation ) );
-            preview->setAlignment( Qt::AlignCenter );
-            preview->setMinimumSize( 150, 110 );
-            preview->setSizePolicy( QSizePolicy::Fixed, QSizePolicy::Fixed );
-            rowLayout->addWidget( preview );
-        }
-
-        auto* optionLayout = new QVBoxLayout();
-        optionLayout->setSpacing( 6 );
-
-        auto* button = new QRadioButton( choice.name, frame );
-        button->setProperty( "choiceId", choice.id );
-        optionLayout->addWidget( button );
-
-        if ( isCustom )
-        {
-            auto* customContainer = new QWidget( frame );
-            auto* customLayout = new QVBoxLayout( customContainer );
-            customLayout->setContentsMargins( 0, 6, 0, 0 );
-            customLayout->setSpacing( 6 );
-
-            auto* packagesLabel = new QLabel( tr( "Packages (space-separated):" ), customContainer );
-            customLayout->addWidget( packagesLabel );
-
-            m_customPackagesEdit = new QPlainTextEdit( customContainer );
-            m_customPackagesEdit->setPlaceholderText(
-                tr( "e.g. plasma-meta konsole dolphin sddm" ) );
-            m_customPackagesEdit->setMaximumHeight( 80 );
-            customLayout->addWidget( m_customPackagesEdit );
-
-            auto* dmLabel = new QLabel( tr( "Display manager:" ), customContainer );
-            customLayout->addWidget( dmLabel );
-
-            m_customDmEdit = new QLineEdit( customContainer );
-            m_customDmEdit->setPlaceholderText( tr( "e.g. sddm, gdm, lightdm" ) );
-            customLayout->addWidget( m_customDmEdit );
-
-            customContainer->setVisible( false );
-            m_customWidget = customContainer;
-            optionLayout->addWidget( customContainer );
-
-            connect(
-                m_customPackagesEdit, &QPlainTextEdit::textChanged, this, [this]() {
-                    if ( m_lastSelection == QStringLiteral( "custom" ) )
-                    {
-                        applySelection( QStringLiteral( "custom" ) );
-                    }
-                } );
-            connect(
-                m_customDmEdit, &QLineEdit::textChanged, this, [this]() {
-                    if ( m_lastSelection == QStringLiteral( "custom" ) )
-                    {
-                        applySelection( QStringLiteral( "custom" ) );
-                    }
-                } );
-        }
-
-        m_choiceGroup->addButton( button );
-        rowLayout->addLayout( optionLayout, 1 );
-
-        connect(
-            button, &QRadioButton::toggled, this, [this, button]( bool checked ) {
-                if ( checked )
-                {
-                    handleSelectionChanged( button->property( "choiceId" ).toString() );
-                }
-            } );
-
-        OptionWidget widget;
-        widget.frame = frame;
-        widget.button = button;
-        m_optionWidgets.insert( choice.id, widget );
-
-        containerLayout->addWidget( frame );
+        choices.append( choice );
     }
+    m_choiceModel->setChoices( choices );
 
-    if ( addedChoices == 0 )
+    if ( choices.isEmpty() )
     {
-        auto* warning = new QLabel( tr( "No desktop environments are available." ), container );
+        auto* warning = new QLabel( tr( "No desktop environments are available." ), page );
         warning->setWordWrap( true );
-        containerLayout->addWidget( warning );
+        layout->addWidget( warning );
         setStatusMessage( tr( "No desktops are configured for installation." ), true );
         setCanProceed( false );
     }
 
-    containerLayout->addStretch();
-
-    scrollArea->setWidget( container );
-    layout->addWidget( scrollArea, 1 );
+    m_choiceDelegate->setColors(
+        { m_frameBorderColor, m_frameHighlightColor, m_frameHighlightBackground, m_mutedTextColor } );
+
+    m_choiceView = new QListView( page );
+    m_choiceView->setModel( m_choiceModel );
+    m_choiceView->setItemDelegate( m_choiceDelegate );
+    m_choiceView->setSelectionMode( QAbstractItemView::SingleSelection );
+    m_choiceView->setVerticalScrollMode( QAbstractItemView::ScrollPerPixel );
+    m_choiceView->setHorizontalScrollBarPolicy( Qt::ScrollBarAlwaysOff );
+    m_choiceView->setUniformItemSizes( true );
+    m_choiceView->setMouseTracking( true );
+    m_choiceView->setVisible( !choices.isEmpty() );
+    layout->addWidget( m_choiceView, 1 );
+
+    connect( m_choiceView->selectionModel(),
+             &QItemSelectionModel::selectionChanged,
+             this,
+             [this]()
+             {
+                 const QModelIndexList selected = m_choiceView->selectionModel()->selectedIndexes();
+                 if ( !m_updatingSelection && !selected.isEmpty() )
+                 {
+                     handleSelectionChanged( selected.first().data( DesktopListModel::IdRole ).toString() );
+                 }
+             } );
+
+    // The custom editor goes with the list rather than into a card, so
+    // cards stay plain painted items
+    auto* customContainer = new QWidget( page );
+    auto* customLayout = new QVBoxLayout( customContainer );
+    customLayout->setContentsMargins( 0, 6, 0, 0 );
+    customLayout->setSpacing( 6 );
+
+    auto* packagesLabel = new QLabel( tr( "Packages (space-separated):" ), customContainer );
+    customLayout->addWidget( packagesLabel );
+
+    m_customPackagesEdit = new PackageListEdit( m_nameIndex, customContainer );
+    m_customPackagesEdit->setPlaceholderText( tr( "e.g. plasma-meta konsole dolphin sddm" ) );
+    m_customPackagesEdit->setMaximumHeight( 80 );
+    customLayout->addWidget( m_customPackagesEdit );
+
+    auto* dmLabel = new QLabel( tr( "Display manager:" ), customContainer );
+    customLayout->addWidget( dmLabel );
+
+    m_customDmEdit = new QLineEdit( customContainer );
+    m_customDmEdit->setPlaceholderText( tr( "e.g. sddm, gdm, lightdm" ) );
+    customLayout->addWidget( m_customDmEdit );
+
+    m_customPackagesEdit->setPlainText( SetupJournal::value( s_journalCustom, QStringLiteral( "packages" ) ).toString() );
+    m_customDmEdit->setText( SetupJournal::value( s_journalCustom, QStringLiteral( "displayManager" ) ).toString() );
+
+    customContainer->setVisible( false );
+    m_customWidget = customContainer;
+    layout->addWidget( customContainer );
+
+    connect(
+        m_customPackagesEdit, &QPlainTextEdit::textChanged, this, [this]() {
+            if ( m_lastSelection == QStringLiteral( "custom" ) )
+            {
+                applySelection( QStringLiteral( "custom" ), true );
+            }
+        } );
+    connect(
+        m_customDmEdit, &QLineEdit::textChanged, this, [this]() {
+            if ( m_lastSelection == QStringLiteral( "custom" ) )
+            {
+                applySelection( QStringLiteral( "custom" ), true );
+            }
+        } );
 }
 
 void
@@ -503,13 +669,20 @@ DePackagesViewStep::handleSelectionChanged( const QString& selectionId )
         m_customWidget->setVisible( selectionId == QStringLiteral( "custom" ) );
     }
 
-    gs->insert( QStringLiteral( "packagechooser_packagechooser" ), selectionId );
-    applySelection( selectionId );
+    gs->insert( s_selectionKey, selectionId );
+    if ( applySelection( selectionId ) && m_prefetchEnabled && !m_offline )
+    {
+        m_prefetcher->prefetch( m_selectedPackages );
+    }
 }
 
 bool
-DePackagesViewStep::applySelection( const QString& selection )
+DePackagesViewStep::applySelection( const QString& selection, bool deferCommit )
 {
+    // A commit still pending is for the previous input; invalid input
+    // must not let it reach GlobalStorage and /tmp
+    m_commitTimer->stop();
+
     auto* gs = Calamares::JobQueue::instanceGlobalStorage();
     if ( !gs )
     {
@@ -530,6 +703,7 @@ DePackagesViewStep::applySelection( const QString& selection )
             setCanProceed( false );
             return false;
         }
+        m_nameIndex->load( m_offline );
 
         const QString rawText = m_customPackagesEdit->toPlainText().trimmed();
         if ( rawText.isEmpty() )
@@ -537,14 +711,13 @@ DePackagesViewStep::applySelection( const QString& selection )
             setStatusMessage( tr( "Enter at least one package to continue." ), true );
             setCanProceed( false );
             m_lastSelection = selection;
-            selectButtonForId( selection );
+            selectChoice( selection );
             return false;
         }
 
         packages.append( QStringLiteral( "asahi-desktop-meta" ) );
 
-        const QStringList tokens = rawText.split( QRegularExpression( QStringLiteral( "\\s+" ) ),
-                                                   Qt::SkipEmptyParts );
+        const QStringList tokens = rawText.split( s_whitespace, Qt::SkipEmptyParts );
         for ( const QString& token : tokens )
         {
             const QString pkg = token.trimmed();
@@ -560,13 +733,24 @@ DePackagesViewStep::applySelection( const QString& selection )
             setStatusMessage( tr( "Enter a display manager to continue." ), true );
             setCanProceed( false );
             m_lastSelection = selection;
-            selectButtonForId( selection );
+            selectChoice( selection );
             return false;
         }
         if ( !packages.contains( displayManager ) )
         {
             packages.append( displayManager );
         }
+
+        // Until the index is loaded the install job is the judge
+        const QStringList unknown = m_nameIndex->unknownNames( packages );
+        if ( !unknown.isEmpty() )
+        {
+            setStatusMessage( tr( "No repository has %1." ).arg( unknown.join( QStringLiteral( ", " ) ) ), true );
+            setCanProceed( false );
+            m_lastSelection = selection;
+            selectChoice( selection );
+            return false;
+        }
     }
     else
     {
@@ -583,106 +767,210 @@ DePackagesViewStep::applySelection( const QString& selection )
         displayManager = it.value().displayManager;
     }
 
+    m_lastSelection = selection;
+    m_selectedPackages = packages;
+    m_selectedDisplayManager = displayManager;
+    selectChoice( selection );
+
+    setStatusMessage(
+        tr( "%1 will install: %2." ).arg( selection, formatPackages( packages ) ),
+        false );
+    setCanProceed( true );
+
+    if ( deferCommit )
+    {
+        m_commitTimer->start();
+    }
+    else
+    {
+        commitSelection();
+    }
+    return true;
+}
+
+void
+DePackagesViewStep::commitSelection()
+{
+    m_commitTimer->stop();
+
+    auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+    if ( !gs || m_lastSelection.isEmpty() || m_selectedPackages.isEmpty() )
+    {
+        return;
+    }
+
+    cDebug() << "de-packages: selection" << m_lastSelection;
+    cDebug() << "de-packages: packages" << m_selectedPackages;
+    cDebug() << "de-packages: display manager" << m_selectedDisplayManager;
+
     QVariantMap installOperation;
-    installOperation.insert( QStringLiteral( "install" ), packages );
+    installOperation.insert( QStringLiteral( "install" ), m_selectedPackages );
     QVariantList packageOperations;
     packageOperations.append( installOperation );
     gs->insert( QStringLiteral( "packageOperations" ), packageOperations );
 
-    QFile dmFile( QStringLiteral( "/tmp/calamares-dm" ) );
-    if ( dmFile.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text ) )
+    m_writer->write( QStringLiteral( "/tmp/calamares-dm" ), m_selectedDisplayManager.toUtf8() );
+    m_writer->write( QStringLiteral( "/tmp/calamares-de" ), m_lastSelection.toUtf8() );
+    m_writer->write( QStringLiteral( "/tmp/calamares-packages" ),
+                     m_selectedPackages.join( QStringLiteral( " " ) ).toUtf8() );
+    const QString username = gs->value( QStringLiteral( "username" ) ).toString();
+    if ( !username.isEmpty() )
     {
-        QTextStream out( &dmFile );
-        out << displayManager;
-        dmFile.close();
+        m_writer->write( QStringLiteral( "/tmp/calamares-user" ), username.toUtf8() );
     }
-    else
+
+    publishPlan();
+}
+
+void
+DePackagesViewStep::onGlobalStorageChanged()
+{
+    auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+    if ( !gs )
     {
-        cWarning() << "de-packages: could not write display manager selection" << dmFile.errorString();
+        return;
     }
 
-    QFile deFile( QStringLiteral( "/tmp/calamares-de" ) );
-    if ( deFile.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text ) )
+    // Prefer what networksetup measured over the configured guess
+    const qreal measuredRate = gs->value( s_mirrorThroughputKey ).toDouble();
+    if ( measuredRate > 0 && !qFuzzyCompare( measuredRate, m_downloadRate ) )
     {
-        QTextStream out( &deFile );
-        out << selection;
-        deFile.close();
+        m_downloadRate = measuredRate;
+        for ( const DesktopChoice& choice : m_choiceModel->choices() )
+        {
+            if ( m_resolver->hasPlan( choice.id ) )
+            {
+                updateSizeLabel( choice.id );
+            }
+        }
     }
-    else
+
+    // Going offline or syncing the databases makes every plan stale
+    const bool offline = gs->value( s_offlineKey ).toBool();
+    const bool synced = gs->value( s_databasesSyncedKey ).toBool();
+    if ( offline == m_offline && ( m_databasesSynced || !synced ) )
     {
-        cWarning() << "de-packages: could not write desktop selection" << deFile.errorString();
+        return;
     }
-
-    QFile pkgFile( QStringLiteral( "/tmp/calamares-packages" ) );
-    if ( pkgFile.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text ) )
+    m_offline = offline;
+    m_databasesSynced = m_databasesSynced || synced;
+    m_prefetcher->setDatabasesSynced( m_databasesSynced );
+    if ( m_offline )
     {
-        QTextStream out( &pkgFile );
-        out << packages.join( QStringLiteral( " " ) );
-        pkgFile.close();
+        m_prefetcher->cancel();
     }
-    else
+    if ( m_widget )
+    {
+        resolveDesktops();
+    }
+    if ( m_nameIndex->isRequested() )
     {
-        cWarning() << "de-packages: could not write package list" << pkgFile.errorString();
+        m_nameIndex->load( m_offline, true );
     }
+}
 
-    const QString username = gs->value( QStringLiteral( "username" ) ).toString();
-    if ( !username.isEmpty() )
+void
+DePackagesViewStep::resolveDesktops()
+{
+    QHash< QString, QStringList > desktops;
+    for ( const DesktopChoice& choice : m_choiceModel->choices() )
     {
-        QFile userFile( QStringLiteral( "/tmp/calamares-user" ) );
-        if ( userFile.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text ) )
+        const auto desktop = s_desktops.constFind( choice.id );
+        if ( desktop == s_desktops.constEnd() )
         {
-            QTextStream out( &userFile );
-            out << username;
-            userFile.close();
+            continue;
         }
-        else
+        desktops.insert( choice.id, desktop.value().packages );
+        if ( !m_resolver->hasPlan( choice.id ) )
         {
-            cWarning() << "de-packages: could not write username" << userFile.errorString();
+            m_choiceModel->setDetail( choice.id, tr( "Calculating download size ..." ) );
         }
     }
+    m_resolver->resolve( desktops, m_offline );
+}
 
-    m_lastSelection = selection;
-    selectButtonForId( selection );
+void
+DePackagesViewStep::updateSizeLabel( const QString& id )
+{
+    if ( !s_desktops.contains( id ) )
+    {
+        return;
+    }
 
-    cDebug() << "de-packages: selection" << selection;
-    cDebug() << "de-packages: packages" << packages;
-    cDebug() << "de-packages: display manager" << displayManager;
+    const DesktopPlan plan = m_resolver->plan( id );
+    // Offline only what the local repository covers can be installed
+    m_choiceModel->setAvailable( id, plan.isValid() || !m_offline );
+    if ( !plan.isValid() )
+    {
+        m_choiceModel->setDetail( id,
+                                  m_offline ? tr( "Not available without a network connection" )
+                                            : tr( "Download size unavailable" ) );
+        return;
+    }
 
-    setStatusMessage(
-        tr( "%1 will install: %2." ).arg( selection, formatPackages( packages ) ),
-        false );
-    setCanProceed( true );
-    return true;
+    const QLocale locale;
+    const qreal seconds = plan.downloadSize / m_downloadRate + plan.installedSize / m_installRate;
+    const int minutes = qMax( 1, qRound( seconds / 60.0 ) );
+    m_choiceModel->setDetail( id,
+                              tr( "Download %1 · Installed %2 · about %n minute(s)", nullptr, minutes )
+                                  .arg( locale.formattedDataSize( plan.downloadSize ),
+                                        locale.formattedDataSize( plan.installedSize ) ) );
 }
 
 void
-DePackagesViewStep::selectButtonForId( const QString& selection )
+DePackagesViewStep::publishPlan()
 {
-    if ( !m_choiceGroup )
+    auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+    if ( !gs )
     {
         return;
     }
 
-    const bool clearing = selection.isEmpty();
-    if ( clearing )
+    // The install job only trusts a plan for exactly the selected targets
+    const DesktopPlan plan = m_resolver->plan( m_lastSelection );
+    if ( m_offline && m_resolver->hasPlan( m_lastSelection ) && !plan.isValid() )
+    {
+        setStatusMessage( tr( "%1 is not available without a network connection." ).arg( m_lastSelection ), true );
+        setCanProceed( false );
+    }
+    if ( plan.isValid() && plan.targets == m_selectedPackages )
+    {
+        gs->insert( s_planKey, plan.toMap() );
+        SetupJournal::insert( s_journalGlobalStorage, s_planKey, plan.toMap() );
+    }
+    else if ( gs->contains( s_planKey ) )
     {
-        m_choiceGroup->setExclusive( false );
+        gs->remove( s_planKey );
+        SetupJournal::remove( s_journalGlobalStorage, s_planKey );
     }
+}
 
-    const auto buttons = m_choiceGroup->buttons();
-    for ( QAbstractButton* button : buttons )
+void
+DePackagesViewStep::selectChoice( const QString& selection )
+{
+    if ( !m_choiceView )
     {
-        QSignalBlocker blocker( button );
-        const bool match = !clearing && ( button->property( "choiceId" ).toString() == selection );
-        button->setChecked( match );
+        return;
     }
 
-    if ( clearing )
+    // Only the user's clicks go through handleSelectionChanged()
+    m_updatingSelection = true;
+    const QModelIndex index = m_choiceModel->indexOf( selection );
+    if ( index.isValid() )
     {
-        m_choiceGroup->setExclusive( true );
+        m_choiceView->selectionModel()->setCurrentIndex( index, QItemSelectionModel::ClearAndSelect );
+        m_choiceView->scrollTo( index );
     }
+    else
+    {
+        m_choiceView->selectionModel()->clearSelection();
+    }
+    m_updatingSelection = false;
 
-    updateFrameHighlights( clearing ? QString() : selection );
+    if ( m_customWidget )
+    {
+        m_customWidget->setVisible( selection == QStringLiteral( "custom" ) );
+    }
 }
 
 QVector< DesktopChoice >
@@ -707,37 +995,6 @@ DePackagesViewStep::availableChoices() const
     return defaults;
 }
 
-void
-DePackagesViewStep::updateFrameHighlights( const QString& selection )
-{
-    const bool hasSelection = !selection.isEmpty();
-    for ( auto it = m_optionWidgets.begin(); it != m_optionWidgets.end(); ++it )
-    {
-        const bool selected = hasSelection && ( it.key() == selection );
-        if ( it.value().frame )
-        {
-            it.value().frame->setStyleSheet( frameStyleSheet( selected ) );
-        }
-    }
-}
-
-QString
-DePackagesViewStep::frameStyleSheet( bool selected ) const
-{
-    const QColor borderColor = selected && m_frameHighlightColor.isValid() ? m_frameHighlightColor : m_frameBorderColor;
-    const int borderWidth = selected ? 2 : 1;
-    QString style = QStringLiteral( "QFrame { border-radius: 10px; border: %1px solid %2;" )
-                        .arg( borderWidth )
-                        .arg( borderColor.isValid() ? borderColor.name() : QStringLiteral( "#808080" ) );
-    if ( selected && m_frameHighlightBackground.isValid() )
-    {
-        style.append(
-            QStringLiteral( " background-color: %1;" ).arg( m_frameHighlightBackground.name( QColor::HexArgb ) ) );
-    }
-    style.append( QStringLiteral( " }" ) );
-    return style;
-}
-
 void
 DePackagesViewStep::setCanProceed( bool enabled )
 {
@@ -762,19 +1019,19 @@ DePackagesViewStep::updateSelection()
         return;
     }
 
-    const QString selection = gs->value( QStringLiteral( "packagechooser_packagechooser" ) ).toString();
+    const QString selection = gs->value( s_selectionKey ).toString();
     if ( selection.isEmpty() )
     {
         setStatusMessage( tr( "Select a desktop to continue." ), true );
         setCanProceed( false );
         m_lastSelection.clear();
-        selectButtonForId( QString() );
+        selectChoice( QString() );
         return;
     }
 
     if ( ( selection == m_lastSelection ) && !m_statusIsError )
     {
-        selectButtonForId( selection );
+        selectChoice( selection );
         setCanProceed( true );
         return;
     }
@@ -790,47 +1047,86 @@ DePackagesViewStep::setStatusMessage( const QString& message, bool isError )
 
     if ( m_statusLabel )
     {
+        // A palette change repaints the label; a style sheet would
+        // re-polish it against the whole branding stylesheet
         m_statusLabel->setText( message );
-        m_statusLabel->setStyleSheet( isError ? QStringLiteral( "color: #c62828;" )
-                                              : QStringLiteral( "color: #2e7d32;" ) );
+        m_statusLabel->setPalette( statusPalette( m_statusLabel->palette(), isError ) );
     }
 }
 
-QPixmap
-DePackagesViewStep::loadScreenshot( const QString& path ) const
+QPalette
+DePackagesViewStep::statusPalette( QPalette palette, bool isError )
 {
-    if ( path.isEmpty() )
-    {
-        return QPixmap();
-    }
+    palette.setColor( QPalette::WindowText, isError ? s_errorColor : s_successColor );
+    return palette;
+}
 
-    const auto* branding = Calamares::Branding::instance();
-    if ( branding )
+QPixmap
+DePackagesViewStep::previewPixmap( const QModelIndex& index, qreal dpr )
+{
+    // Until the screenshot is decoded, or if there is none, the card
+    // shows its name instead
+    const QString screenshot = index.data( DesktopListModel::ScreenshotRole ).toString();
+    if ( !screenshot.isEmpty() )
     {
-        QFileInfo localFile( branding->componentDirectory() + QLatin1Char( '/' ) + path );
-        if ( localFile.exists() && localFile.isFile() )
+        const QStringList candidates = screenshotCandidates( screenshot, dpr );
+        const QPixmap pixmap = m_thumbnails->thumbnail( candidates, s_previewSize, dpr );
+        if ( !pixmap.isNull() )
         {
-            QPixmap pixmap( localFile.absoluteFilePath() );
-            if ( !pixmap.isNull() )
+            return pixmap;
+        }
+        const auto* branding = Calamares::Branding::instance();
+        if ( branding && m_thumbnails->hasFailed( candidates ) )
+        {
+            // Not a file; the branding may still know it as an icon name
+            const QPixmap icon = branding->image( screenshot, s_previewSize );
+            if ( !icon.isNull() )
             {
-                return pixmap;
+                return icon;
             }
         }
+    }
 
-        QPixmap brandedPix = branding->image( path, QSize( 160, 120 ) );
-        if ( !brandedPix.isNull() )
-        {
-            return brandedPix;
-        }
+    const QString label = index.data( Qt::DisplayRole ).toString();
+    const QString key = QStringLiteral( "%1@%2" ).arg( label ).arg( dpr );
+    auto it = m_placeholders.constFind( key );
+    if ( it == m_placeholders.constEnd() )
+    {
+        it = m_placeholders.insert( key, placeholderPixmap( label, dpr ) );
     }
+    return it.value();
+}
 
-    return QPixmap( path );
+QStringList
+DePackagesViewStep::screenshotCandidates( const QString& path, qreal dpr ) const
+{
+    if ( path.isEmpty() )
+    {
+        return QStringList();
+    }
+
+    // The build renders each screenshot at the card size for 1x, 1.5x
+    // and 2x; other scales are scaled from the 2x one at run time. The
+    // originals are not installed; the branding file is only there for
+    // a screenshot added to the configuration after the build.
+    const QString name = QFileInfo( path ).completeBaseName();
+    QStringList candidates;
+    candidates << QStringLiteral( ":/thumbnails/%1@%2x.png" ).arg( name, QString::number( dpr ) )
+               << QStringLiteral( ":/thumbnails/%1@2x.png" ).arg( name );
+    if ( const auto* branding = Calamares::Branding::instance() )
+    {
+        candidates << branding->componentDirectory() + QLatin1Char( '/' ) + path;
+    }
+    candidates << path;
+    return candidates;
 }
 
 QPixmap
-DePackagesViewStep::placeholderPixmap( const QString& label ) const
+DePackagesViewStep::placeholderPixmap( const QString& label, qreal dpr ) const
 {
-    QPixmap pixmap( 200, 120 );
+    const QSize size = QSize( 200, 120 ).scaled( s_previewSize, Qt::KeepAspectRatio );
+    QPixmap pixmap( size * dpr );
+    pixmap.setDevicePixelRatio( dpr );
     pixmap.fill( Qt::transparent );
 
     QPainter painter( &pixmap );
@@ -838,15 +1134,15 @@ DePackagesViewStep::placeholderPixmap( const QString& label ) const
     QColor frameColor = m_frameBorderColor.isValid() ? m_frameBorderColor : QColor( 180, 180, 180 );
     QColor textColor = m_mutedTextColor.isValid() ? m_mutedTextColor : QColor( 80, 80, 80 );
 
-    QRectF rect( 0, 0, pixmap.width(), pixmap.height() );
+    QRectF rect( QPointF( 0, 0 ), QSizeF( size ) );
     painter.setBrush( QColor( frameColor.red(), frameColor.green(), frameColor.blue(), 30 ) );
     painter.setPen( frameColor );
-    painter.drawRoundedRect( rect.adjusted( 4, 4, -4, -4 ), 10, 10 );
+    painter.drawRoundedRect( rect.adjusted( 3, 3, -3, -3 ), 7, 7 );
 
     painter.setPen( textColor );
     QFont font = painter.font();
     font.setBold( true );
-    font.setPointSize( 14 );
+    font.setPointSize( 10 );
     painter.setFont( font );
     painter.drawText( rect, Qt::AlignCenter, label );
 
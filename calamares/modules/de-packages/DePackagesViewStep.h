@@ -7,32 +7,37 @@
 #ifndef DEPACKAGESVIEWSTEP_H
 #define DEPACKAGESVIEWSTEP_H
 
+#include "DesktopListModel.h"
+
 #include "DllMacro.h"
 #include "utils/PluginFactory.h"
 #include "viewpages/ViewStep.h"
 
 #include <QObject>
+#include <QPalette>
 #include <QVector>
 #include <QHash>
 #include <QColor>
 #include <QPixmap>
+#include <QStringList>
+
+#include <memory>
 
 class QWidget;
 class QVBoxLayout;
-class QButtonGroup;
-class QFrame;
-class QRadioButton;
 class QLabel;
-class QPlainTextEdit;
+class QListView;
+class QModelIndex;
 class QLineEdit;
-
-struct DesktopChoice
-{
-    QString id;
-    QString name;
-    QString description;
-    QString screenshot;
-};
+class PackageListEdit;
+class PackageNameIndex;
+class PackagePrefetcher;
+class DesktopResolver;
+class ThumbnailLoader;
+class DesktopDelegate;
+class SelectionWriter;
+class BackgroundInstall;
+class QTimer;
 
 class PLUGINDLLEXPORT DePackagesViewStep : public Calamares::ViewStep
 {
@@ -56,44 +61,80 @@ public:
 
     void setConfigurationMap( const QVariantMap& configurationMap ) override;
     void onActivate() override;
+    void onLeave() override;
 
 private:
     void ensureWidget();
     void updateSelection();
     void setStatusMessage( const QString& message, bool isError );
+    static QPalette statusPalette( QPalette palette, bool isError );
     void buildChoicesUi( QWidget* page, QVBoxLayout* layout );
     void handleSelectionChanged( const QString& selectionId );
-    bool applySelection( const QString& selection );
-    void selectButtonForId( const QString& selection );
-    void updateFrameHighlights( const QString& selection );
+    /** @brief Validate @p selection and show the result
+     *
+     * A valid selection is committed right away, or with @p deferCommit
+     * once m_commitTimer runs out, so typing only validates.
+     */
+    bool applySelection( const QString& selection, bool deferCommit = false );
+    /// Publish the last valid selection to GlobalStorage and /tmp
+    void commitSelection();
+    /// Start the transaction if the user went on to the next page
+    void startOverlappedInstall();
+    /// Record the answers for a rerun if the user went on to the next page
+    void journalAnswers();
+    void onGlobalStorageChanged();
+    void resolveDesktops();
+    void updateSizeLabel( const QString& id );
+    void publishPlan();
+    void selectChoice( const QString& selection );
     QVector< DesktopChoice > availableChoices() const;
-    QString frameStyleSheet( bool selected ) const;
     void setCanProceed( bool enabled );
-    QPixmap loadScreenshot( const QString& path ) const;
-    QPixmap placeholderPixmap( const QString& label ) const;
-
-    struct OptionWidget
-    {
-        QFrame* frame = nullptr;
-        QRadioButton* button = nullptr;
-    };
+    QPixmap previewPixmap( const QModelIndex& index, qreal dpr );
+    QStringList screenshotCandidates( const QString& path, qreal dpr ) const;
+    QPixmap placeholderPixmap( const QString& label, qreal dpr ) const;
 
     QWidget* m_widget = nullptr;
     QLabel* m_statusLabel = nullptr;
-    QButtonGroup* m_choiceGroup = nullptr;
     QVector< DesktopChoice > m_choices;
-    QHash< QString, OptionWidget > m_optionWidgets;
+    QListView* m_choiceView = nullptr;
+    /// Set while the selection is changed from code, not by the user
+    bool m_updatingSelection = false;
+    /// Placeholder previews by label and scale
+    QHash< QString, QPixmap > m_placeholders;
     QString m_lastSelection;
+    QStringList m_selectedPackages;
+    QString m_selectedDisplayManager;
     QString m_statusMessage;
     bool m_statusIsError = false;
     bool m_canProceed = false;
     QWidget* m_customWidget = nullptr;
-    QPlainTextEdit* m_customPackagesEdit = nullptr;
+    PackageListEdit* m_customPackagesEdit = nullptr;
     QLineEdit* m_customDmEdit = nullptr;
     QColor m_frameBorderColor;
     QColor m_frameHighlightColor;
     QColor m_frameHighlightBackground;
     QColor m_mutedTextColor;
+    PackagePrefetcher* m_prefetcher = nullptr;
+    bool m_prefetchEnabled = true;
+    DesktopResolver* m_resolver = nullptr;
+    ThumbnailLoader* m_thumbnails = nullptr;
+    /// Loaded once the custom desktop is chosen
+    PackageNameIndex* m_nameIndex = nullptr;
+    DesktopListModel* m_choiceModel = nullptr;
+    DesktopDelegate* m_choiceDelegate = nullptr;
+    /// Runs commitSelection() once typing in the custom editor pauses
+    QTimer* m_commitTimer = nullptr;
+    std::unique_ptr< SelectionWriter > m_writer;
+    /// Only used with overlapInstall; the exec phase then waits for it
+    std::unique_ptr< BackgroundInstall > m_backgroundInstall;
+    bool m_overlapInstall = false;
+    bool m_databasesSynced = false;
+    bool m_offline = false;
+    /// Rates for the time estimate on the cards, in bytes per second
+    qreal m_downloadRate = 0;
+    qreal m_installRate = 0;
+    /// SetupTrace::now() when the page was shown
+    qint64 m_activatedAt = 0;
 };
 
 CALAMARES_PLUGIN_FACTORY_DECLARATION( DePackagesViewStepFactory )
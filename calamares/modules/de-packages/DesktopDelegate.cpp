@@ -0,0 +1,144 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "DesktopDelegate.h"
+#include "DesktopListModel.h"
+
+#include <QApplication>
+#include <QPainter>
+#include <QPainterPath>
+#include <QStyle>
+#include <QStyleOption>
+
+namespace
+{
+constexpr int s_horizontalMargin = 14;
+constexpr int s_verticalMargin = 12;
+constexpr int s_previewSpacing = 14;
+constexpr int s_textSpacing = 6;
+/// Gap below each card, so they read as separate frames
+constexpr int s_cardSpacing = 10;
+constexpr qreal s_cornerRadius = 10;
+}  // namespace
+
+DesktopDelegate::DesktopDelegate( PreviewProvider preview, QObject* parent )
+    : QStyledItemDelegate( parent )
+    , m_preview( std::move( preview ) )
+{
+}
+
+QSize
+DesktopDelegate::previewBox()
+{
+    return QSize( 150, 110 );
+}
+
+void
+DesktopDelegate::paint( QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index ) const
+{
+    const QWidget* widget = option.widget;
+    QStyle* style = widget ? widget->style() : QApplication::style();
+    const bool enabled = option.state & QStyle::State_Enabled;
+    const bool selected = option.state & QStyle::State_Selected;
+    const QPalette::ColorGroup group = enabled ? QPalette::Normal : QPalette::Disabled;
+
+    painter->save();
+    painter->setRenderHint( QPainter::Antialiasing, true );
+
+    // The card itself
+    const QRect card = option.rect.adjusted( 0, 0, 0, -s_cardSpacing );
+    const qreal borderWidth = selected ? 2 : 1;
+    const QColor border = selected && m_colors.highlight.isValid() ? m_colors.highlight : m_colors.border;
+    QPainterPath outline;
+    const qreal inset = borderWidth / 2;
+    outline.addRoundedRect( QRectF( card ).adjusted( inset, inset, -inset, -inset ), s_cornerRadius, s_cornerRadius );
+    if ( selected && m_colors.highlightBackground.isValid() )
+    {
+        painter->fillPath( outline, m_colors.highlightBackground );
+    }
+    painter->setPen( QPen( border.isValid() ? border : QColor( 128, 128, 128 ), borderWidth ) );
+    painter->drawPath( outline );
+
+    // Screenshot, centered in its box
+    const QRect content = card.adjusted( s_horizontalMargin, s_verticalMargin, -s_horizontalMargin, -s_verticalMargin );
+    QRect box( content.topLeft(), previewBox() );
+    box.moveTop( content.top() + ( content.height() - box.height() ) / 2 );
+    const qreal dpr = widget ? widget->devicePixelRatioF() : qApp->devicePixelRatio();
+    const QPixmap preview = m_preview ? m_preview( index, dpr ) : QPixmap();
+    if ( !preview.isNull() )
+    {
+        QRect target( QPoint(), preview.deviceIndependentSize().toSize() );
+        target.moveCenter( box.center() );
+        if ( !enabled )
+        {
+            painter->setOpacity( 0.5 );
+        }
+        painter->drawPixmap( target, preview );
+        painter->setOpacity( 1.0 );
+    }
+
+    // Radio indicator and name, with the details below
+    QRect text = content.adjusted( box.width() + s_previewSpacing, 0, 0, 0 );
+    const QString detail = index.data( DesktopListModel::DetailRole ).toString();
+    const QFontMetrics metrics( option.font );
+    const int indicatorWidth = style->pixelMetric( QStyle::PM_ExclusiveIndicatorWidth, &option, widget );
+    const int indicatorHeight = style->pixelMetric( QStyle::PM_ExclusiveIndicatorHeight, &option, widget );
+    const int lineHeight = qMax( indicatorHeight, metrics.height() );
+    const QRect detailBounds = detail.isEmpty()
+        ? QRect()
+        : metrics.boundingRect( QRect( 0, 0, text.width(), content.height() ), Qt::TextWordWrap, detail );
+    const int blockHeight = lineHeight + ( detail.isEmpty() ? 0 : s_textSpacing + detailBounds.height() );
+    text.setTop( content.top() + qMax( 0, ( content.height() - blockHeight ) / 2 ) );
+
+    QStyleOptionButton radio;
+    if ( widget )
+    {
+        radio.initFrom( widget );
+    }
+    radio.rect = QRect( text.left(), text.top() + ( lineHeight - indicatorHeight ) / 2, indicatorWidth, indicatorHeight );
+    radio.state = ( enabled ? QStyle::State_Enabled : QStyle::State_None )
+        | ( selected ? QStyle::State_On : QStyle::State_Off );
+    if ( option.state & QStyle::State_MouseOver )
+    {
+        radio.state |= QStyle::State_MouseOver;
+    }
+    style->drawPrimitive( QStyle::PE_IndicatorRadioButton, &radio, painter, widget );
+
+    const int labelSpacing = style->pixelMetric( QStyle::PM_RadioButtonLabelSpacing, &option, widget );
+    const int nameLeft = text.left() + indicatorWidth + labelSpacing;
+    const QRect nameRect( nameLeft, text.top(), text.right() - nameLeft, lineHeight );
+    painter->setFont( option.font );
+    painter->setPen( option.palette.color( group, QPalette::Text ) );
+    painter->drawText( nameRect,
+                       Qt::AlignLeft | Qt::AlignVCenter,
+                       metrics.elidedText( index.data( Qt::DisplayRole ).toString(), Qt::ElideRight, nameRect.width() ) );
+
+    if ( !detail.isEmpty() )
+    {
+        const QRect detailRect( text.left(), text.top() + lineHeight + s_textSpacing, text.width(), detailBounds.height() );
+        painter->setPen( m_colors.mutedText.isValid() && enabled ? m_colors.mutedText
+                                                               : option.palette.color( group, QPalette::Text ) );
+        painter->drawText( detailRect, Qt::AlignLeft | Qt::AlignTop | Qt::TextWordWrap, detail );
+    }
+
+    if ( ( option.state & QStyle::State_HasFocus ) && widget )
+    {
+        QStyleOptionFocusRect focus;
+        focus.initFrom( widget );
+        focus.rect = card.adjusted( 3, 3, -3, -3 );
+        focus.state |= QStyle::State_KeyboardFocusChange;
+        style->drawPrimitive( QStyle::PE_FrameFocusRect, &focus, painter, widget );
+    }
+
+    painter->restore();
+}
+
+QSize
+DesktopDelegate::sizeHint( const QStyleOptionViewItem& option, const QModelIndex& index ) const
+{
+    Q_UNUSED( index )
+    // One size for every card, so the view can lay out any number of them
+    // without asking each one
+    return QSize( option.rect.width(), previewBox().height() + 2 * s_verticalMargin + s_cardSpacing );
+}
@@ -0,0 +1,46 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Paints one desktop of DesktopListModel as a selectable card: the
+ * screenshot, a radio indicator with the name, and the size details.
+ */
+
+#ifndef DESKTOPDELEGATE_H
+#define DESKTOPDELEGATE_H
+
+#include <QColor>
+#include <QPixmap>
+#include <QStyledItemDelegate>
+
+#include <functional>
+
+class DesktopDelegate : public QStyledItemDelegate
+{
+public:
+    /// Pixmap for the card of an index at a device pixel ratio; called on every paint
+    using PreviewProvider = std::function< QPixmap( const QModelIndex&, qreal ) >;
+
+    struct Colors
+    {
+        QColor border;
+        QColor highlight;
+        QColor highlightBackground;
+        QColor mutedText;
+    };
+
+    explicit DesktopDelegate( PreviewProvider preview, QObject* parent = nullptr );
+
+    void setColors( const Colors& colors ) { m_colors = colors; }
+
+    /// The box screenshots are centered in, in device-independent pixels
+    static QSize previewBox();
+
+    void paint( QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index ) const override;
+    QSize sizeHint( const QStyleOptionViewItem& option, const QModelIndex& index ) const override;
+
+private:
+    PreviewProvider m_preview;
+    Colors m_colors;
+};
+
+#endif  // DESKTOPDELEGATE_H
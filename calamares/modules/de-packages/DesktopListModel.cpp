@@ -0,0 +1,109 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "DesktopListModel.h"
+
+DesktopListModel::DesktopListModel( QObject* parent )
+    : QAbstractListModel( parent )
+{
+}
+
+void
+DesktopListModel::setChoices( const QVector< DesktopChoice >& choices )
+{
+    beginResetModel();
+    m_choices = choices;
+    m_details = QVector< QString >( choices.size() );
+    m_available = QVector< bool >( choices.size(), true );
+    m_rows.clear();
+    for ( int row = 0; row < m_choices.size(); ++row )
+    {
+        m_rows.insert( m_choices.at( row ).id, row );
+    }
+    endResetModel();
+}
+
+QModelIndex
+DesktopListModel::indexOf( const QString& id ) const
+{
+    const auto it = m_rows.constFind( id );
+    return it == m_rows.constEnd() ? QModelIndex() : index( it.value() );
+}
+
+void
+DesktopListModel::setDetail( const QString& id, const QString& detail )
+{
+    const QModelIndex changed = indexOf( id );
+    if ( !changed.isValid() || m_details.at( changed.row() ) == detail )
+    {
+        return;
+    }
+    m_details[ changed.row() ] = detail;
+    emit dataChanged( changed, changed, { DetailRole } );
+}
+
+void
+DesktopListModel::setAvailable( const QString& id, bool available )
+{
+    const QModelIndex changed = indexOf( id );
+    if ( !changed.isValid() || m_available.at( changed.row() ) == available )
+    {
+        return;
+    }
+    m_available[ changed.row() ] = available;
+    emit dataChanged( changed, changed );
+}
+
+void
+DesktopListModel::previewChanged( const QString& id )
+{
+    const QModelIndex changed = indexOf( id );
+    if ( changed.isValid() )
+    {
+        emit dataChanged( changed, changed, { Qt::DecorationRole } );
+    }
+}
+
+int
+DesktopListModel::rowCount( const QModelIndex& parent ) const
+{
+    return parent.isValid() ? 0 : m_choices.size();
+}
+
+QVariant
+DesktopListModel::data( const QModelIndex& index, int role ) const
+{
+    if ( !index.isValid() || index.row() >= m_choices.size() )
+    {
+        return QVariant();
+    }
+
+    const DesktopChoice& choice = m_choices.at( index.row() );
+    switch ( role )
+    {
+    case Qt::DisplayRole:
+        return choice.name;
+    case Qt::ToolTipRole:
+        return choice.description.isEmpty() ? QVariant() : choice.description;
+    case Qt::AccessibleDescriptionRole:
+    case DetailRole:
+        return m_details.at( index.row() );
+    case IdRole:
+        return choice.id;
+    case ScreenshotRole:
+        return choice.screenshot;
+    default:
+        return QVariant();
+    }
+}
+
+Qt::ItemFlags
+DesktopListModel::flags( const QModelIndex& index ) const
+{
+    if ( !index.isValid() || index.row() >= m_choices.size() || !m_available.at( index.row() ) )
+    {
+        return Qt::NoItemFlags;
+    }
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
@@ -0,0 +1,62 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * The desktops offered on the de-packages page. The list view only
+ * creates what is visible, so the page costs the same however many
+ * items de-packages.conf lists.
+ */
+
+#ifndef DESKTOPLISTMODEL_H
+#define DESKTOPLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QVector>
+
+struct DesktopChoice
+{
+    QString id;
+    QString name;
+    QString description;
+    QString screenshot;
+};
+
+class DesktopListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Role
+    {
+        IdRole = Qt::UserRole + 1,
+        /// Sizes and time estimate, or why the desktop is unavailable
+        DetailRole,
+        /// Screenshot name from the configuration, may be empty
+        ScreenshotRole
+    };
+
+    explicit DesktopListModel( QObject* parent = nullptr );
+
+    void setChoices( const QVector< DesktopChoice >& choices );
+    const QVector< DesktopChoice >& choices() const { return m_choices; }
+
+    QModelIndex indexOf( const QString& id ) const;
+
+    void setDetail( const QString& id, const QString& detail );
+    /// Unavailable desktops are shown, but cannot be selected
+    void setAvailable( const QString& id, bool available );
+    /// The preview of @p id can be painted sharper now; repaints that card only
+    void previewChanged( const QString& id );
+
+    int rowCount( const QModelIndex& parent = QModelIndex() ) const override;
+    QVariant data( const QModelIndex& index, int role = Qt::DisplayRole ) const override;
+    Qt::ItemFlags flags( const QModelIndex& index ) const override;
+
+private:
+    QVector< DesktopChoice > m_choices;
+    QVector< QString > m_details;
+    QVector< bool > m_available;
+    QHash< QString, int > m_rows;
+};
+
+#endif  // DESKTOPLISTMODEL_H
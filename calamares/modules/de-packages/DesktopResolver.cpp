@@ -0,0 +1,175 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "DesktopResolver.h"
+
+#include "AlpmSession.h"
+#include "SetupTrace.h"
+
+#include "utils/Logger.h"
+
+QVariantMap
+DesktopPlan::toMap() const
+{
+    return QVariantMap { { QStringLiteral( "targets" ), targets },
+                         { QStringLiteral( "packages" ), packages },
+                         { QStringLiteral( "explicit" ), explicitPackages },
+                         { QStringLiteral( "downloadSize" ), downloadSize },
+                         { QStringLiteral( "installedSize" ), installedSize },
+                         { QStringLiteral( "fingerprint" ), fingerprint } };
+}
+
+DesktopPlan
+DesktopPlan::fromMap( const QVariantMap& map )
+{
+    DesktopPlan plan;
+    plan.targets = map.value( QStringLiteral( "targets" ) ).toStringList();
+    plan.packages = map.value( QStringLiteral( "packages" ) ).toStringList();
+    plan.explicitPackages = map.value( QStringLiteral( "explicit" ) ).toStringList();
+    plan.downloadSize = map.value( QStringLiteral( "downloadSize" ) ).toLongLong();
+    plan.installedSize = map.value( QStringLiteral( "installedSize" ) ).toLongLong();
+    plan.fingerprint = map.value( QStringLiteral( "fingerprint" ) ).toString();
+    return plan;
+}
+
+DesktopPlan
+DesktopPlan::resolve( AlpmSession& session, const QStringList& targets )
+{
+    DesktopPlan plan;
+    plan.targets = targets;
+    plan.fingerprint = session.databaseFingerprint();
+
+    QStringList missing;
+    const auto packages = session.findTargets( targets, &missing );
+    if ( !missing.isEmpty() )
+    {
+        plan.error = QStringLiteral( "not found: %1" ).arg( missing.join( QStringLiteral( ", " ) ) );
+        return plan;
+    }
+
+    // NOLOCK: this only reads, exactly like pacman --print
+    alpm_handle_t* handle = session.handle();
+    if ( alpm_trans_init( handle, ALPM_TRANS_FLAG_NEEDED | ALPM_TRANS_FLAG_NOLOCK ) != 0 )
+    {
+        plan.error = session.errorString();
+        return plan;
+    }
+
+    for ( alpm_pkg_t* pkg : packages )
+    {
+        alpm_add_pkg( handle, pkg );
+        plan.explicitPackages << QString::fromLocal8Bit( alpm_pkg_get_name( pkg ) );
+    }
+
+    alpm_list_t* data = nullptr;
+    if ( alpm_trans_prepare( handle, &data ) != 0 )
+    {
+        const alpm_errno_t err = alpm_errno( handle );
+        plan.error = session.errorString();
+        const QString details = AlpmSession::prepareErrorDetails( err, data );
+        if ( !details.isEmpty() )
+        {
+            plan.error += QLatin1Char( '\n' ) + details;
+        }
+        alpm_trans_release( handle );
+        return plan;
+    }
+
+    for ( alpm_list_t* i = alpm_trans_get_add( handle ); i; i = alpm_list_next( i ) )
+    {
+        auto* pkg = static_cast< alpm_pkg_t* >( i->data );
+        plan.packages << QString::fromLocal8Bit( alpm_pkg_get_name( pkg ) );
+        plan.downloadSize += static_cast< qint64 >( alpm_pkg_download_size( pkg ) );
+        plan.installedSize += static_cast< qint64 >( alpm_pkg_get_isize( pkg ) );
+    }
+    alpm_trans_release( handle );
+    return plan;
+}
+
+DesktopResolver::DesktopResolver( QObject* parent )
+    : QObject( parent )
+{
+    m_pool.setMaxThreadCount( 1 );
+}
+
+DesktopResolver::~DesktopResolver()
+{
+    if ( m_cancel )
+    {
+        *m_cancel = true;
+    }
+    m_pool.waitForDone();
+}
+
+void
+DesktopResolver::resolve( const QHash< QString, QStringList >& desktops, bool offline )
+{
+    m_pending = desktops;
+    m_pendingOffline = offline;
+    if ( m_running )
+    {
+        *m_cancel = true;
+        return;
+    }
+    start();
+}
+
+void
+DesktopResolver::start()
+{
+    if ( m_pending.isEmpty() )
+    {
+        return;
+    }
+
+    const QHash< QString, QStringList > desktops = m_pending;
+    const bool offline = m_pendingOffline;
+    m_pending.clear();
+    m_running = true;
+    auto cancel = std::make_shared< std::atomic_bool >( false );
+    m_cancel = cancel;
+
+    m_pool.start(
+        [this, desktops, offline, cancel]()
+        {
+            AlpmSession session;
+            if ( session.initializeForInstall( offline ) )
+            {
+                QStringList ids = desktops.keys();
+                ids.sort();
+                for ( const QString& id : ids )
+                {
+                    if ( *cancel )
+                    {
+                        break;
+                    }
+                    SetupTrace::Span trace( QStringLiteral( "resolve" ), QStringLiteral( "resolve" ) );
+                    trace.setArg( QStringLiteral( "desktop" ), id );
+                    const DesktopPlan plan = DesktopPlan::resolve( session, desktops.value( id ) );
+                    trace.setArg( QStringLiteral( "packages" ), int( plan.packages.size() ) );
+                    if ( !plan.error.isEmpty() )
+                    {
+                        cWarning() << "de-packages: could not resolve" << id << plan.error;
+                    }
+                    QMetaObject::invokeMethod(
+                        this,
+                        [this, id, plan]()
+                        {
+                            m_plans.insert( id, plan );
+                            emit resolved( id );
+                        },
+                        Qt::QueuedConnection );
+                }
+            }
+
+            QMetaObject::invokeMethod(
+                this,
+                [this]()
+                {
+                    m_running = false;
+                    start();
+                },
+                Qt::QueuedConnection );
+        } );
+}
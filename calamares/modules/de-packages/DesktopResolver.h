@@ -0,0 +1,78 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Resolves the full package closure of each desktop off the UI thread,
+ * so the cards can show sizes and the install job can skip solving.
+ */
+
+#ifndef DESKTOPRESOLVER_H
+#define DESKTOPRESOLVER_H
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVariantMap>
+
+#include <atomic>
+#include <memory>
+
+class AlpmSession;
+
+struct DesktopPlan
+{
+    /// Names the desktop asks for (packages, provisions or groups)
+    QStringList targets;
+    /// Every package the transaction installs or upgrades
+    QStringList packages;
+    /// The subset of @c packages that are explicit targets
+    QStringList explicitPackages;
+    qint64 downloadSize = 0;
+    qint64 installedSize = 0;
+    /// AlpmSession::databaseFingerprint() the plan was resolved against
+    QString fingerprint;
+    QString error;
+
+    bool isValid() const { return error.isEmpty() && !fingerprint.isEmpty(); }
+
+    QVariantMap toMap() const;
+    static DesktopPlan fromMap( const QVariantMap& map );
+
+    /// Resolve @p targets against the sync databases of @p session.
+    static DesktopPlan resolve( AlpmSession& session, const QStringList& targets );
+};
+
+class DesktopResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DesktopResolver( QObject* parent = nullptr );
+    ~DesktopResolver() override;
+
+    /** @brief Resolve every desktop in @p desktops (id to targets)
+     *
+     * With @p offline only the local repository is consulted. A request
+     * made while a resolution runs replaces whatever is left of the
+     * running one.
+     */
+    void resolve( const QHash< QString, QStringList >& desktops, bool offline );
+
+    bool hasPlan( const QString& id ) const { return m_plans.contains( id ); }
+    DesktopPlan plan( const QString& id ) const { return m_plans.value( id ); }
+
+signals:
+    void resolved( const QString& id );
+
+private:
+    void start();
+
+    QThreadPool m_pool;
+    QHash< QString, DesktopPlan > m_plans;
+    QHash< QString, QStringList > m_pending;
+    bool m_pendingOffline = false;
+    std::shared_ptr< std::atomic_bool > m_cancel;
+    bool m_running = false;
+};
+
+#endif  // DESKTOPRESOLVER_H
@@ -0,0 +1,480 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "PackageDownloader.h"
+
+#include "utils/Logger.h"
+
+#include <QCryptographicHash>
+#include <QEventLoop>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTimer>
+#include <QUrl>
+
+namespace
+{
+// Packages larger than one segment are fetched as several ranges
+constexpr qint64 s_segmentSize = 4 * 1024 * 1024;
+constexpr int s_maxConnections = 16;
+// Past the first few entries of the ranked list mirrors only slow things down
+constexpr int s_maxMirrors = 3;
+constexpr int s_maxSegmentAttempts = 3;
+// Failed requests after which a mirror is not used again
+constexpr int s_badMirrorFailures = 2;
+constexpr int s_transferTimeoutMs = 30000;
+constexpr int s_rateWindowMs = 1000;
+// Segmented partial files, which libalpm must not mistake for its own
+const QString s_segmentedPartSuffix = QStringLiteral( ".calamares-part" );
+}  // namespace
+
+PackageDownloader::PackageDownloader( const QString& cacheDir, int connections, QObject* parent )
+    : QObject( parent )
+    , m_cacheDir( cacheDir.endsWith( QLatin1Char( '/' ) ) ? cacheDir : cacheDir + QLatin1Char( '/' ) )
+    , m_network( new QNetworkAccessManager( this ) )
+    , m_rateTimer( new QTimer( this ) )
+    , m_connections( qBound( 1, connections, s_maxConnections ) )
+{
+    m_rateTimer->setInterval( s_rateWindowMs );
+    connect( m_rateTimer, &QTimer::timeout, this, &PackageDownloader::adjustConnections );
+}
+
+PackageDownloader::~PackageDownloader()
+{
+    // Partial files stay on disk, the next run resumes them
+    const auto replies = m_active.keys();
+    for ( QNetworkReply* reply : replies )
+    {
+        reply->disconnect( this );
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+bool
+PackageDownloader::run( const QVector< DownloadItem >& items )
+{
+    m_items.clear();
+    m_queue.clear();
+    m_total = 0;
+    m_downloaded = 0;
+    m_windowBytes = 0;
+    m_lastRate = 0;
+
+    for ( const DownloadItem& item : items )
+    {
+        ItemState state;
+        state.item = item;
+        state.item.servers.clear();
+        // file:// repositories are read in place by libalpm; bad mirrors
+        // stay at the end in case nothing else is left
+        QStringList bad;
+        for ( const QString& server : item.servers )
+        {
+            if ( server.startsWith( QStringLiteral( "http" ) ) )
+            {
+                ( isBadMirror( QUrl( server ).host() ) ? bad : state.item.servers ) << server;
+            }
+        }
+        state.item.servers = ( state.item.servers + bad ).mid( 0, s_maxMirrors );
+        m_items.append( state );
+    }
+    for ( int i = 0; i < m_items.size(); ++i )
+    {
+        prepareItem( i );
+    }
+
+    if ( !m_queue.isEmpty() )
+    {
+        QEventLoop loop;
+        connect( this, &PackageDownloader::done, &loop, &QEventLoop::quit );
+        emit progress( m_downloaded, m_total );
+        m_rateTimer->start();
+        startRequests();
+        if ( !isDone() )
+        {
+            loop.exec();
+        }
+        m_rateTimer->stop();
+    }
+
+    return failedFiles().isEmpty();
+}
+
+QStringList
+PackageDownloader::failedFiles() const
+{
+    QStringList files;
+    for ( const ItemState& state : m_items )
+    {
+        if ( state.failed )
+        {
+            files << state.item.fileName;
+        }
+    }
+    return files;
+}
+
+void
+PackageDownloader::excludeMirrors( const QSet< QString >& hosts )
+{
+    for ( const QString& host : hosts )
+    {
+        m_mirrorFailures[ host ] = qMax( m_mirrorFailures.value( host ), s_badMirrorFailures );
+    }
+}
+
+QSet< QString >
+PackageDownloader::badMirrors() const
+{
+    QSet< QString > hosts;
+    for ( auto it = m_mirrorFailures.constBegin(); it != m_mirrorFailures.constEnd(); ++it )
+    {
+        if ( it.value() >= s_badMirrorFailures )
+        {
+            hosts.insert( it.key() );
+        }
+    }
+    return hosts;
+}
+
+bool
+PackageDownloader::isBadMirror( const QString& host ) const
+{
+    return m_mirrorFailures.value( host ) >= s_badMirrorFailures;
+}
+
+QString
+PackageDownloader::partPath( const ItemState& state ) const
+{
+    // A segmented file is allocated at full size up front. Under pacman's
+    // name, libalpm would take it for a finished download and resume
+    // from its end when it has to fetch the package itself.
+    const QString suffix = state.segmentCount > 1 ? s_segmentedPartSuffix : QStringLiteral( ".part" );
+    return m_cacheDir + state.item.fileName + suffix;
+}
+
+QString
+PackageDownloader::statePath( const ItemState& state ) const
+{
+    return m_cacheDir + state.item.fileName + s_segmentedPartSuffix + QStringLiteral( ".segments" );
+}
+
+void
+PackageDownloader::prepareItem( int index )
+{
+    ItemState& state = m_items[ index ];
+    const qint64 size = state.item.size;
+    m_total += size;
+
+    if ( QFile::exists( m_cacheDir + state.item.fileName ) )
+    {
+        m_downloaded += size;
+        state.finished = true;
+        return;
+    }
+    if ( state.item.servers.isEmpty() )
+    {
+        failItem( state, QStringLiteral( "no HTTP mirror" ) );
+        return;
+    }
+
+    state.segmentCount = size > s_segmentSize ? int( ( size + s_segmentSize - 1 ) / s_segmentSize ) : 1;
+
+    QFile record( statePath( state ) );
+    if ( state.segmentCount > 1 && record.open( QIODevice::ReadOnly | QIODevice::Text ) )
+    {
+        while ( !record.atEnd() )
+        {
+            bool ok = false;
+            const int segment = record.readLine().trimmed().toInt( &ok );
+            if ( ok && segment >= 0 && segment < state.segmentCount )
+            {
+                state.completed.insert( segment );
+            }
+        }
+    }
+
+    state.file = new QFile( partPath( state ), this );
+    qint64 resumeFrom = 0;
+    if ( state.segmentCount == 1 )
+    {
+        // Same layout as pacman's own .part files: resume from their end
+        resumeFrom = state.file->exists() ? qMin( state.file->size(), size ) : 0;
+    }
+    else if ( state.completed.isEmpty() )
+    {
+        // Without the segment record, nothing in an old .part can be trusted
+        state.file->remove();
+    }
+
+    if ( !state.file->open( QIODevice::ReadWrite ) )
+    {
+        failItem( state, state.file->errorString() );
+        return;
+    }
+    if ( state.segmentCount > 1 && !state.file->resize( size ) )
+    {
+        failItem( state, state.file->errorString() );
+        return;
+    }
+
+    bool queued = false;
+    for ( int i = 0; i < state.segmentCount; ++i )
+    {
+        Segment segment;
+        segment.item = index;
+        segment.index = i;
+        segment.start = i * s_segmentSize + ( state.segmentCount == 1 ? resumeFrom : 0 );
+        segment.end = qMin( size, ( i + 1 ) * s_segmentSize ) - 1;
+        if ( state.completed.contains( i ) || segment.start > segment.end )
+        {
+            m_downloaded += segment.end - i * s_segmentSize + 1;
+            continue;
+        }
+        m_downloaded += segment.start - i * s_segmentSize;
+        m_queue.enqueue( segment );
+        queued = true;
+    }
+
+    if ( !queued )
+    {
+        finishItem( state );
+    }
+}
+
+void
+PackageDownloader::startRequests()
+{
+    while ( m_active.size() < m_connections && !m_queue.isEmpty() )
+    {
+        const Segment segment = m_queue.dequeue();
+        if ( !m_items.at( segment.item ).failed )
+        {
+            startSegment( segment );
+        }
+    }
+}
+
+void
+PackageDownloader::startSegment( Segment segment )
+{
+    const ItemState& state = m_items.at( segment.item );
+    const QStringList& servers = state.item.servers;
+
+    // Neighbouring segments go to different mirrors, retries to the next
+    // one, and bad mirrors only when nothing else is left
+    const int first = segment.item + segment.index + segment.attempts;
+    QString server = servers.at( first % servers.size() );
+    for ( int i = 0; i < servers.size(); ++i )
+    {
+        const QString& candidate = servers.at( ( first + i ) % servers.size() );
+        if ( !isBadMirror( QUrl( candidate ).host() ) )
+        {
+            server = candidate;
+            break;
+        }
+    }
+    segment.host = QUrl( server ).host();
+
+    QNetworkRequest request( QUrl( server + QLatin1Char( '/' ) + state.item.fileName ) );
+    if ( segment.start > 0 || segment.end < state.item.size - 1 )
+    {
+        request.setRawHeader( "Range", QStringLiteral( "bytes=%1-%2" ).arg( segment.start ).arg( segment.end ).toLatin1() );
+    }
+    request.setTransferTimeout( s_transferTimeoutMs );
+
+    QNetworkReply* reply = m_network->get( request );
+    m_active.insert( reply, segment );
+    connect( reply, &QNetworkReply::readyRead, this, [this, reply]() { onReadyRead( reply ); } );
+    connect( reply, &QNetworkReply::finished, this, [this, reply]() { onFinished( reply ); } );
+}
+
+void
+PackageDownloader::onReadyRead( QNetworkReply* reply )
+{
+    const auto it = m_active.find( reply );
+    if ( it == m_active.end() )
+    {
+        return;
+    }
+    Segment& segment = it.value();
+    ItemState& state = m_items[ segment.item ];
+    if ( state.failed )
+    {
+        reply->abort();
+        return;
+    }
+
+    const bool ranged = segment.start > 0 || segment.end < state.item.size - 1;
+    const int status = reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+    const QByteArray data = reply->readAll();
+    const qint64 room = segment.end - ( segment.start + segment.received ) + 1;
+    if ( ( ranged && status != 206 ) || data.size() > room )
+    {
+        // The mirror ignored the range; writing this would corrupt the file
+        reply->abort();
+        return;
+    }
+
+    if ( !state.file->seek( segment.start + segment.received ) || state.file->write( data ) != data.size() )
+    {
+        failItem( state, state.file->errorString() );
+        reply->abort();
+        return;
+    }
+
+    segment.received += data.size();
+    m_downloaded += data.size();
+    m_windowBytes += data.size();
+    emit progress( m_downloaded, m_total );
+}
+
+void
+PackageDownloader::onFinished( QNetworkReply* reply )
+{
+    if ( !m_active.contains( reply ) )
+    {
+        return;
+    }
+    const Segment segment = m_active.take( reply );
+    reply->deleteLater();
+
+    if ( !m_items.at( segment.item ).failed )
+    {
+        if ( reply->error() == QNetworkReply::NoError && segment.received == segment.end - segment.start + 1 )
+        {
+            completeSegment( segment );
+        }
+        else
+        {
+            segmentFailed( segment,
+                           reply->error() != QNetworkReply::NoError ? reply->errorString()
+                                                                    : QStringLiteral( "short read" ) );
+        }
+    }
+
+    startRequests();
+    if ( isDone() )
+    {
+        emit done();
+    }
+}
+
+void
+PackageDownloader::segmentFailed( Segment segment, const QString& reason )
+{
+    ItemState& state = m_items[ segment.item ];
+    cWarning() << "de-packages: download of" << state.item.fileName << "segment" << segment.index
+               << "failed:" << reason;
+
+    // Multiplicative decrease: errors usually mean too many connections
+    m_connections = qMax( 1, m_connections / 2 );
+    m_lastRate = 0;
+    if ( ++m_mirrorFailures[ segment.host ] == s_badMirrorFailures )
+    {
+        cWarning() << "de-packages: not using mirror" << segment.host << "any more";
+    }
+
+    if ( state.segmentCount == 1 )
+    {
+        // A single stream is written in order, so keep what arrived
+        segment.start += segment.received;
+    }
+    else
+    {
+        m_downloaded -= segment.received;
+    }
+    segment.received = 0;
+
+    if ( ++segment.attempts >= qMax( s_maxSegmentAttempts, int( state.item.servers.size() ) ) )
+    {
+        failItem( state, reason );
+        return;
+    }
+    m_queue.enqueue( segment );
+}
+
+void
+PackageDownloader::completeSegment( const Segment& segment )
+{
+    ItemState& state = m_items[ segment.item ];
+    state.completed.insert( segment.index );
+
+    if ( state.segmentCount > 1 )
+    {
+        state.file->flush();
+        QFile record( statePath( state ) );
+        if ( record.open( QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text ) )
+        {
+            record.write( QByteArray::number( segment.index ) + '\n' );
+        }
+    }
+
+    if ( state.completed.size() == state.segmentCount )
+    {
+        finishItem( state );
+    }
+}
+
+void
+PackageDownloader::finishItem( ItemState& state )
+{
+    state.file->flush();
+    if ( !state.item.sha256.isEmpty() )
+    {
+        QCryptographicHash hash( QCryptographicHash::Sha256 );
+        state.file->seek( 0 );
+        if ( !hash.addData( state.file ) || hash.result() != state.item.sha256 )
+        {
+            state.file->remove();
+            QFile::remove( statePath( state ) );
+            failItem( state, QStringLiteral( "checksum mismatch" ) );
+            return;
+        }
+    }
+
+    state.file->close();
+    if ( !state.file->rename( m_cacheDir + state.item.fileName ) )
+    {
+        failItem( state, state.file->errorString() );
+        return;
+    }
+    QFile::remove( statePath( state ) );
+    state.finished = true;
+}
+
+void
+PackageDownloader::failItem( ItemState& state, const QString& reason )
+{
+    cWarning() << "de-packages: could not download" << state.item.fileName << reason;
+    state.failed = true;
+    if ( state.file )
+    {
+        state.file->close();
+    }
+}
+
+void
+PackageDownloader::adjustConnections()
+{
+    const qint64 rate = m_windowBytes * 1000 / s_rateWindowMs;
+    m_windowBytes = 0;
+
+    // Additive increase while another connection still buys bandwidth
+    if ( rate > m_lastRate + m_lastRate / 20 && m_connections < s_maxConnections && !m_queue.isEmpty() )
+    {
+        ++m_connections;
+        startRequests();
+    }
+    m_lastRate = rate;
+}
+
+bool
+PackageDownloader::isDone() const
+{
+    return m_active.isEmpty() && m_queue.isEmpty();
+}
@@ -0,0 +1,115 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Fills pacman's package cache before a transaction commits: large
+ * packages are fetched in ranges from several mirrors at once, partial
+ * files survive between attempts, and the number of connections follows
+ * the measured bandwidth.
+ */
+
+#ifndef PACKAGEDOWNLOADER_H
+#define PACKAGEDOWNLOADER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+class QFile;
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+
+struct DownloadItem
+{
+    QString fileName;
+    /// Repository base URLs, best first
+    QStringList servers;
+    qint64 size = 0;
+    /// Raw SHA-256 digest from the sync database, if it has one
+    QByteArray sha256;
+};
+
+class PackageDownloader : public QObject
+{
+    Q_OBJECT
+
+public:
+    PackageDownloader( const QString& cacheDir, int connections, QObject* parent = nullptr );
+    ~PackageDownloader() override;
+
+    /** @brief Download @p items into the cache directory
+     *
+     * Runs a local event loop until every item is complete or has
+     * failed on all of its mirrors. Returns true if nothing failed.
+     */
+    bool run( const QVector< DownloadItem >& items );
+
+    /// Files that could not be downloaded during the last run()
+    QStringList failedFiles() const;
+
+    /// Never pick mirrors on these hosts while another one is available
+    void excludeMirrors( const QSet< QString >& hosts );
+    /// Hosts that failed repeatedly, including the excluded ones
+    QSet< QString > badMirrors() const;
+
+signals:
+    void progress( qint64 downloaded, qint64 total );
+    void done();
+
+private:
+    struct Segment
+    {
+        int item = 0;
+        int index = 0;
+        qint64 start = 0;
+        qint64 end = 0;  // inclusive
+        qint64 received = 0;
+        int attempts = 0;
+        QString host;
+    };
+
+    struct ItemState
+    {
+        DownloadItem item;
+        QFile* file = nullptr;
+        QSet< int > completed;
+        int segmentCount = 0;
+        bool failed = false;
+        bool finished = false;
+    };
+
+    void prepareItem( int index );
+    void startRequests();
+    void startSegment( Segment segment );
+    void onReadyRead( QNetworkReply* reply );
+    void onFinished( QNetworkReply* reply );
+    void segmentFailed( Segment segment, const QString& reason );
+    void completeSegment( const Segment& segment );
+    void finishItem( ItemState& state );
+    void failItem( ItemState& state, const QString& reason );
+    void adjustConnections();
+    bool isDone() const;
+    bool isBadMirror( const QString& host ) const;
+
+    QString partPath( const ItemState& state ) const;
+    QString statePath( const ItemState& state ) const;
+
+    QString m_cacheDir;
+    QNetworkAccessManager* m_network = nullptr;
+    QTimer* m_rateTimer = nullptr;
+    QVector< ItemState > m_items;
+    QQueue< Segment > m_queue;
+    QHash< QNetworkReply*, Segment > m_active;
+    QHash< QString, int > m_mirrorFailures;
+    int m_connections = 1;
+    qint64 m_total = 0;
+    qint64 m_downloaded = 0;
+    qint64 m_windowBytes = 0;
+    qint64 m_lastRate = 0;
+};
+
+#endif  // PACKAGEDOWNLOADER_H
@@ -0,0 +1,741 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "PackageInstallJob.h"
+
+#include "AlpmSession.h"
+#include "DatabaseSync.h"
+#include "DesktopResolver.h"
+#include "PackageDownloader.h"
+#include "PacmanProcess.h"
+#include "SetupJournal.h"
+#include "SetupTrace.h"
+
+#include "GlobalStorage.h"
+#include "JobQueue.h"
+#include "utils/Logger.h"
+
+#include <QDir>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QThread>
+#include <QUrl>
+#include <QVariantList>
+#include <QVariantMap>
+
+#include <cstdio>
+
+namespace
+{
+constexpr int s_maxAttempts = 5;
+// Retry delays double from the base up to the cap
+constexpr unsigned long s_retryBaseMs = 2000;
+constexpr unsigned long s_retryMaxMs = 60000;
+
+// Share of the job's progress bar given to each phase
+constexpr qreal s_syncShare = 0.05;
+constexpr qreal s_downloadShare = 0.45;
+
+// True if @p message names @p host on its own, not as part of a longer name
+bool
+mentionsHost( const QString& message, const QString& host )
+{
+    const auto isHostChar = []( QChar c ) { return c.isLetterOrNumber() || c == u'.' || c == u'-'; };
+    for ( int at = message.indexOf( host ); at >= 0; at = message.indexOf( host, at + 1 ) )
+    {
+        const int end = at + host.size();
+        if ( ( at == 0 || !isHostChar( message.at( at - 1 ) ) )
+             && ( end == message.size() || !isHostChar( message.at( end ) ) ) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Setup journal entry recording a committed transaction
+const QString s_journalSteps = QStringLiteral( "completedSteps" );
+const QString s_journalStep = QStringLiteral( "de-packages" );
+
+}  // namespace
+
+PackageInstallJob::PackageInstallJob( QObject* parent )
+    : Calamares::Job( parent )
+{
+}
+
+PackageInstallJob::~PackageInstallJob() = default;
+
+QString
+PackageInstallJob::prettyName() const
+{
+    return tr( "Installing desktop packages" );
+}
+
+QString
+PackageInstallJob::prettyStatusMessage() const
+{
+    return m_status.isEmpty() ? prettyName() : m_status;
+}
+
+Calamares::JobResult
+PackageInstallJob::exec()
+{
+    const QStringList targets = targetsFromGlobalStorage();
+    if ( targets.isEmpty() )
+    {
+        return Calamares::JobResult::error( tr( "No packages to install." ),
+                                            tr( "The desktop selection did not produce a package list." ) );
+    }
+
+    cDebug() << "de-packages: installing" << targets;
+    SetupTrace::Span trace( QStringLiteral( "install-job" ), QStringLiteral( "install" ) );
+    trace.setArg( QStringLiteral( "targets" ), targets );
+
+    auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+    const bool offline = gs && gs->value( QStringLiteral( "offlineInstall" ) ).toBool();
+    if ( offline )
+    {
+        cDebug() << "de-packages: installing from the local repository only";
+    }
+
+    AlpmSession session;
+    if ( !session.initializeForInstall( offline ) )
+    {
+        return Calamares::JobResult::error( tr( "Could not initialize the package manager." ),
+                                            session.errorString() );
+    }
+
+    if ( completedInEarlierRun( session, targets ) )
+    {
+        cDebug() << "de-packages: packages were installed by an earlier run, nothing to do";
+        trace.setArg( QStringLiteral( "resumed" ), true );
+        return Calamares::JobResult::ok();
+    }
+
+    m_mirrorHosts.clear();
+    for ( const PacmanRepository& repo : session.config().repositories )
+    {
+        for ( const QString& server : repo.servers )
+        {
+            const QString host = QUrl( server ).host();
+            if ( !host.isEmpty() )
+            {
+                m_mirrorHosts.insert( host );
+            }
+        }
+    }
+
+    alpm_handle_t* handle = session.handle();
+    alpm_option_set_logcb( handle, &PackageInstallJob::logCallback, this );
+    alpm_option_set_eventcb( handle, &PackageInstallJob::eventCallback, this );
+    alpm_option_set_questioncb( handle, &PackageInstallJob::questionCallback, this );
+    alpm_option_set_progresscb( handle, &PackageInstallJob::progressCallback, this );
+    alpm_option_set_dlcb( handle, &PackageInstallJob::downloadCallback, this );
+
+    const DesktopPlan plan = planFromGlobalStorage( targets );
+    // Only the first attempt may rely on the background sync done by the
+    // networksetup module; later ones refresh only when the failure calls for it.
+    SyncMode sync = offline || databasesFreshThisSession() ? SyncMode::None : SyncMode::Force;
+    // Whether the databases of this attempt are as new as they get
+    bool databasesCurrent = offline || sync == SyncMode::None;
+    int fetchFailures = 0;
+    AttemptResult result;
+    for ( int attempt = 1; attempt <= s_maxAttempts; ++attempt )
+    {
+        cDebug() << "de-packages: installation attempt" << attempt << "of" << s_maxAttempts;
+        trace.setArg( QStringLiteral( "attempts" ), attempt );
+        waitForDatabaseLock( session );
+        session.dropMirrors( m_badMirrors );
+        m_failedFiles.clear();
+
+        bool synced = true;
+        if ( sync != SyncMode::None )
+        {
+            m_status = tr( "Synchronizing package databases" );
+            setPhase( Phase::Sync, 0 );
+            SetupTrace::Span syncTrace( QStringLiteral( "database-sync" ), QStringLiteral( "install" ) );
+            synced = session.updateDatabases( sync == SyncMode::Force );
+            syncTrace.setArg( QStringLiteral( "force" ), sync == SyncMode::Force );
+            syncTrace.setArg( QStringLiteral( "ok" ), synced );
+            databasesCurrent = databasesCurrent || synced;
+            if ( !synced )
+            {
+                result.ok = false;
+                result.failure = Failure::Sync;
+                result.message = tr( "Could not synchronize the package databases." );
+                result.details = session.errorString();
+            }
+        }
+        if ( synced )
+        {
+            // The page resolved the transaction already; it still holds
+            // as long as the databases have not changed since.
+            const bool usePlan = plan.isValid() && plan.fingerprint == session.databaseFingerprint();
+            if ( usePlan )
+            {
+                cDebug() << "de-packages: using the resolved plan of" << plan.packages.size() << "packages";
+            }
+            result = installTargets( session, targets, usePlan ? &plan : nullptr );
+        }
+
+        trace.setArg( QStringLiteral( "ok" ), result.ok );
+        if ( result.ok )
+        {
+            cDebug() << "de-packages: package installation successful";
+            SetupJournal::insert( s_journalSteps, s_journalStep, QVariantMap { { QStringLiteral( "targets" ), targets } } );
+            return Calamares::JobResult::ok();
+        }
+
+        if ( !m_failedFiles.isEmpty() )
+        {
+            m_failedFiles.removeDuplicates();
+            result.details += tr( "\nFailed downloads: %1" ).arg( m_failedFiles.join( QStringLiteral( ", " ) ) );
+        }
+        cWarning() << "de-packages: installation attempt" << attempt << "failed:" << result.message
+                   << result.details;
+        if ( result.failure == Failure::Fatal )
+        {
+            break;
+        }
+        if ( result.failure == Failure::NotFound && databasesCurrent )
+        {
+            // Current databases without the name mean a typo, which every
+            // further attempt would run into again
+            break;
+        }
+
+        // Whatever is in the cache and databases stays; the next attempt
+        // only fetches what is still missing or out of date.
+        switch ( result.failure )
+        {
+        case Failure::Sync:
+            // Only a corrupt database needs to be downloaded again in full
+            sync = ( session.lastError() == ALPM_ERR_DB_INVALID || session.lastError() == ALPM_ERR_DB_INVALID_SIG )
+                ? SyncMode::Force
+                : SyncMode::Update;
+            break;
+        case Failure::NotFound:
+        case Failure::Resolve:
+            sync = SyncMode::Update;
+            break;
+        case Failure::Fetch:
+            // Packages missing on every mirror mean our databases are behind
+            sync = ++fetchFailures > 1 ? SyncMode::Update : SyncMode::None;
+            break;
+        default:
+            sync = SyncMode::None;
+            break;
+        }
+
+        if ( attempt < s_maxAttempts )
+        {
+            const unsigned long delay = retryDelay( attempt );
+            m_status = tr( "Installation attempt %1 failed, retrying in %n second(s)", nullptr, int( delay / 1000 ) )
+                           .arg( attempt );
+            reportProgress( 0 );
+            QThread::msleep( delay );
+        }
+    }
+
+    return Calamares::JobResult::error(
+        result.message,
+        result.details
+            + tr( "\n\nPlease check your internet connection and mirror configuration. "
+                  "You can try running 'pacman -Syyu' manually after rebooting." ) );
+}
+
+PackageInstallJob::AttemptResult
+PackageInstallJob::installTargets( AlpmSession& session, const QStringList& names, const DesktopPlan* plan )
+{
+    AttemptResult result;
+
+    QStringList missing;
+    const auto packages = session.findTargets( plan ? plan->packages : names, &missing );
+    if ( !missing.isEmpty() )
+    {
+        result.failure = Failure::NotFound;
+        result.message = tr( "Some packages could not be found." );
+        result.details = missing.join( QStringLiteral( ", " ) );
+        return result;
+    }
+
+    alpm_handle_t* handle = session.handle();
+    // With a plan the closure is complete, so skip dependency resolution
+    const int flags = plan ? ( ALPM_TRANS_FLAG_NEEDED | ALPM_TRANS_FLAG_NODEPS ) : ALPM_TRANS_FLAG_NEEDED;
+    if ( alpm_trans_init( handle, flags ) != 0 )
+    {
+        result.failure = Failure::Other;
+        result.message = tr( "Could not start the package transaction." );
+        result.details = session.errorString();
+        return result;
+    }
+
+    for ( alpm_pkg_t* pkg : packages )
+    {
+        if ( alpm_add_pkg( handle, pkg ) != 0 && alpm_errno( handle ) != ALPM_ERR_TRANS_DUP_TARGET )
+        {
+            result.failure = Failure::Other;
+            result.message = tr( "Could not add %1 to the transaction." )
+                                 .arg( QString::fromLocal8Bit( alpm_pkg_get_name( pkg ) ) );
+            result.details = session.errorString();
+            alpm_trans_release( handle );
+            return result;
+        }
+    }
+
+    alpm_list_t* data = nullptr;
+    if ( alpm_trans_prepare( handle, &data ) != 0 )
+    {
+        const alpm_errno_t err = alpm_errno( handle );
+        result.failure = Failure::Resolve;
+        result.message = tr( "Could not resolve package dependencies: %1" ).arg( session.errorString() );
+        result.details = AlpmSession::prepareErrorDetails( err, data );
+        alpm_trans_release( handle );
+        return result;
+    }
+
+    if ( !alpm_trans_get_add( handle ) )
+    {
+        cDebug() << "de-packages: all packages are already installed";
+        alpm_trans_release( handle );
+        result.ok = true;
+        return result;
+    }
+
+    // Every package added directly is explicit; remember which ones the
+    // solver would have pulled in, so they can be marked as dependencies.
+    QStringList newDependencies;
+    if ( plan )
+    {
+        alpm_db_t* localdb = alpm_get_localdb( handle );
+        for ( alpm_list_t* i = alpm_trans_get_add( handle ); i; i = alpm_list_next( i ) )
+        {
+            const char* name = alpm_pkg_get_name( static_cast< alpm_pkg_t* >( i->data ) );
+            if ( !plan->explicitPackages.contains( QString::fromLocal8Bit( name ) )
+                 && !alpm_db_get_pkg( localdb, name ) )
+            {
+                newDependencies << QString::fromLocal8Bit( name );
+            }
+        }
+    }
+
+    m_downloadTotal = 0;
+    m_downloadedBytes = 0;
+    m_downloaded.clear();
+    m_status = tr( "Downloading packages" );
+    setPhase( Phase::Download, 0 );
+    downloadTransaction( session );
+
+    data = nullptr;
+    SetupTrace::Span commitTrace( QStringLiteral( "commit" ), QStringLiteral( "install" ) );
+    if ( alpm_trans_commit( handle, &data ) != 0 )
+    {
+        const alpm_errno_t err = alpm_errno( handle );
+        commitTrace.setArg( QStringLiteral( "error" ), QString::fromLocal8Bit( alpm_strerror( err ) ) );
+        switch ( err )
+        {
+        case ALPM_ERR_RETRIEVE:
+        case ALPM_ERR_PKG_INVALID:
+        case ALPM_ERR_PKG_INVALID_CHECKSUM:
+        case ALPM_ERR_PKG_INVALID_SIG:
+            // libalpm deletes corrupt files, so they are fetched again
+            result.failure = Failure::Fetch;
+            break;
+        case ALPM_ERR_FILE_CONFLICTS:
+        case ALPM_ERR_DISK_SPACE:
+            result.failure = Failure::Fatal;
+            break;
+        default:
+            result.failure = Failure::Other;
+            break;
+        }
+        result.message = tr( "Package installation failed: %1" ).arg( session.errorString() );
+        result.details = AlpmSession::commitErrorDetails( err, data );
+        alpm_trans_release( handle );
+        return result;
+    }
+
+    alpm_trans_release( handle );
+    markAsDependencies( session, newDependencies );
+    setPhase( Phase::Install, 1 );
+    result.ok = true;
+    return result;
+}
+
+void
+PackageInstallJob::downloadTransaction( AlpmSession& session )
+{
+    alpm_handle_t* handle = session.handle();
+    QVector< DownloadItem > items;
+    for ( alpm_list_t* i = alpm_trans_get_add( handle ); i; i = alpm_list_next( i ) )
+    {
+        auto* pkg = static_cast< alpm_pkg_t* >( i->data );
+        if ( alpm_pkg_download_size( pkg ) == 0 )
+        {
+            continue;
+        }
+
+        DownloadItem item;
+        item.fileName = QString::fromLocal8Bit( alpm_pkg_get_filename( pkg ) );
+        item.size = static_cast< qint64 >( alpm_pkg_get_size( pkg ) );
+        if ( const char* sha256 = alpm_pkg_get_sha256sum( pkg ) )
+        {
+            item.sha256 = QByteArray::fromHex( sha256 );
+        }
+        for ( alpm_list_t* s = alpm_db_get_servers( alpm_pkg_get_db( pkg ) ); s; s = alpm_list_next( s ) )
+        {
+            item.servers << QString::fromLocal8Bit( static_cast< const char* >( s->data ) );
+        }
+        items.append( item );
+    }
+    if ( items.isEmpty() )
+    {
+        return;
+    }
+
+    SetupTrace::Span trace( QStringLiteral( "download" ), QStringLiteral( "install" ) );
+    trace.setArg( QStringLiteral( "files" ), int( items.size() ) );
+
+    // Whatever this cannot fetch, libalpm downloads itself during commit.
+    // The job object lives in the UI thread, hence the direct connection.
+    PackageDownloader downloader( session.config().cacheDirs.first(), session.config().parallelDownloads );
+    connect( &downloader,
+             &PackageDownloader::progress,
+             this,
+             [this]( qint64 downloaded, qint64 total )
+             {
+                 if ( total > 0 )
+                 {
+                     reportProgress( qreal( downloaded ) / qreal( total ) );
+                 }
+             },
+             Qt::DirectConnection );
+    downloader.excludeMirrors( m_badMirrors );
+    if ( !downloader.run( items ) )
+    {
+        cWarning() << "de-packages: left to the package manager:" << downloader.failedFiles();
+        trace.setArg( QStringLiteral( "failed" ), downloader.failedFiles() );
+    }
+    m_badMirrors = downloader.badMirrors();
+    session.dropMirrors( m_badMirrors );
+}
+
+void
+PackageInstallJob::markAsDependencies( AlpmSession& session, const QStringList& names )
+{
+    if ( names.isEmpty() )
+    {
+        return;
+    }
+
+    // Same as pacman -D --asdeps: the transaction only takes the lock
+    alpm_handle_t* handle = session.handle();
+    if ( alpm_trans_init( handle, 0 ) != 0 )
+    {
+        cWarning() << "de-packages: could not set install reasons:" << session.errorString();
+        return;
+    }
+    alpm_db_t* localdb = alpm_get_localdb( handle );
+    for ( const QString& name : names )
+    {
+        alpm_pkg_t* pkg = alpm_db_get_pkg( localdb, name.toLocal8Bit().constData() );
+        if ( !pkg || alpm_pkg_set_reason( pkg, ALPM_PKG_REASON_DEPEND ) != 0 )
+        {
+            cWarning() << "de-packages: could not mark" << name << "as a dependency";
+        }
+    }
+    alpm_trans_release( handle );
+}
+
+void
+PackageInstallJob::setPhase( Phase phase, qreal fraction )
+{
+    m_phase = phase;
+    reportProgress( fraction );
+}
+
+void
+PackageInstallJob::reportProgress( qreal fraction )
+{
+    fraction = qBound( 0.0, fraction, 1.0 );
+    qreal overall = 0;
+    switch ( m_phase )
+    {
+    case Phase::Sync:
+        overall = s_syncShare * fraction;
+        break;
+    case Phase::Download:
+        overall = s_syncShare + s_downloadShare * fraction;
+        break;
+    case Phase::Install:
+        overall = s_syncShare + s_downloadShare + ( 1.0 - s_syncShare - s_downloadShare ) * fraction;
+        break;
+    }
+    emit progress( overall );
+}
+
+void
+PackageInstallJob::waitForDatabaseLock( const AlpmSession& session ) const
+{
+    // A background prefetch or database sync holds the lock while it runs;
+    // it fetches what we need anyway, so wait for it instead of failing.
+    const QString lock = session.config().lockFile();
+    while ( PacmanProcess::holdsLock( lock ) )
+    {
+        cDebug() << "de-packages: waiting for background package operations to finish";
+        QThread::sleep( 5 );
+    }
+}
+
+QStringList
+PackageInstallJob::targetsFromGlobalStorage()
+{
+    QStringList targets;
+    auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+    if ( !gs )
+    {
+        return targets;
+    }
+
+    const QVariantList operations = gs->value( QStringLiteral( "packageOperations" ) ).toList();
+    for ( const QVariant& operation : operations )
+    {
+        const QVariantMap map = operation.toMap();
+        for ( auto it = map.constBegin(); it != map.constEnd(); ++it )
+        {
+            if ( it.key() == QStringLiteral( "install" ) )
+            {
+                targets << it.value().toStringList();
+            }
+            else
+            {
+                cWarning() << "de-packages: unsupported package operation" << it.key();
+            }
+        }
+    }
+    targets.removeDuplicates();
+    return targets;
+}
+
+DesktopPlan
+PackageInstallJob::planFromGlobalStorage( const QStringList& targets )
+{
+    auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+    if ( !gs )
+    {
+        return DesktopPlan();
+    }
+
+    // An earlier run may have resolved the same selection already
+    const QVariant stored = gs->contains( QStringLiteral( "packagePlan" ) )
+        ? gs->value( QStringLiteral( "packagePlan" ) )
+        : SetupJournal::value( QStringLiteral( "globalStorage" ), QStringLiteral( "packagePlan" ) );
+    const DesktopPlan plan = DesktopPlan::fromMap( stored.toMap() );
+    return plan.targets == targets ? plan : DesktopPlan();
+}
+
+bool
+PackageInstallJob::completedInEarlierRun( AlpmSession& session, const QStringList& targets )
+{
+    const QVariantMap step = SetupJournal::value( s_journalSteps, s_journalStep ).toMap();
+    if ( step.value( QStringLiteral( "targets" ) ).toStringList() != targets )
+    {
+        return false;
+    }
+
+    // The journal only says the transaction committed; trust it as long
+    // as every target is still there
+    alpm_list_t* installed = alpm_db_get_pkgcache( alpm_get_localdb( session.handle() ) );
+    for ( const QString& target : targets )
+    {
+        if ( !alpm_find_satisfier( installed, target.toLocal8Bit().constData() ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned long
+PackageInstallJob::retryDelay( int attempt )
+{
+    const unsigned long delay = qMin( s_retryMaxMs, s_retryBaseMs << qMin( attempt - 1, 16 ) );
+    // Half fixed, half random, so retries do not line up with whatever
+    // made the mirror fail in the first place
+    return delay / 2 + QRandomGenerator::global()->bounded( quint32( delay / 2 + 1 ) );
+}
+
+bool
+PackageInstallJob::databasesFreshThisSession()
+{
+    const QByteArray session = qgetenv( "ASAHI_SETUP_SESSION" );
+    if ( session.isEmpty() )
+    {
+        return false;
+    }
+    QFile stamp( DatabaseSync::stampFile() );
+    return stamp.open( QIODevice::ReadOnly ) && stamp.readAll().trimmed() == session;
+}
+
+void
+PackageInstallJob::logCallback( void* ctx, alpm_loglevel_t level, const char* fmt, va_list args )
+{
+    if ( !( level & ( ALPM_LOG_ERROR | ALPM_LOG_WARNING ) ) )
+    {
+        return;
+    }
+
+    char buffer[ 1024 ];
+    vsnprintf( buffer, sizeof( buffer ), fmt, args );
+    const QString message = QString::fromLocal8Bit( buffer ).trimmed();
+
+    // libalpm names the server only in its messages ("failed retrieving
+    // file ... from <host>", "too many errors from <host>"), which may be
+    // translated; looking for the configured hosts works in any language.
+    auto* job = static_cast< PackageInstallJob* >( ctx );
+    for ( const QString& host : std::as_const( job->m_mirrorHosts ) )
+    {
+        if ( !job->m_badMirrors.contains( host ) && mentionsHost( message, host ) )
+        {
+            cWarning() << "de-packages: not using mirror" << host << "any more";
+            job->m_badMirrors.insert( host );
+        }
+    }
+    if ( level & ALPM_LOG_ERROR )
+    {
+        cWarning() << "de-packages: alpm:" << message;
+    }
+    else
+    {
+        cDebug() << "de-packages: alpm:" << message;
+    }
+}
+
+void
+PackageInstallJob::eventCallback( void* ctx, alpm_event_t* event )
+{
+    auto* job = static_cast< PackageInstallJob* >( ctx );
+    switch ( event->type )
+    {
+    case ALPM_EVENT_DB_RETRIEVE_START:
+        job->m_status = tr( "Synchronizing package databases" );
+        job->setPhase( Phase::Sync, 0 );
+        break;
+    case ALPM_EVENT_PKG_RETRIEVE_START:
+        job->m_downloadTotal = static_cast< qint64 >( event->pkg_retrieve.total_size );
+        job->m_downloadedBytes = 0;
+        job->m_downloaded.clear();
+        job->m_status = tr( "Downloading %1 packages" ).arg( event->pkg_retrieve.num );
+        job->setPhase( Phase::Download, 0 );
+        break;
+    case ALPM_EVENT_TRANSACTION_START:
+        job->m_status = tr( "Installing packages" );
+        job->setPhase( Phase::Install, 0 );
+        break;
+    case ALPM_EVENT_HOOK_RUN_START:
+        job->m_status = tr( "Running post-install hooks (%1 of %2)" )
+                            .arg( event->hook_run.position )
+                            .arg( event->hook_run.total );
+        job->reportProgress( 1 );
+        break;
+    case ALPM_EVENT_SCRIPTLET_INFO:
+        cDebug() << "de-packages:" << QString::fromLocal8Bit( event->scriptlet_info.line ).trimmed();
+        break;
+    default:
+        break;
+    }
+}
+
+void
+PackageInstallJob::questionCallback( void*, alpm_question_t* question )
+{
+    // Answer everything the way pacman --noconfirm would
+    int answer = 0;
+    switch ( question->type )
+    {
+    case ALPM_QUESTION_INSTALL_IGNOREPKG:
+    case ALPM_QUESTION_REPLACE_PKG:
+    case ALPM_QUESTION_CORRUPTED_PKG:
+    case ALPM_QUESTION_IMPORT_KEY:
+        // pacman asks these [Y/n]; an IgnorePkg target named explicitly
+        // is still installed.
+        answer = 1;
+        break;
+    default:
+        // No to conflicts and skipping unresolvable packages; first provider.
+        answer = 0;
+        break;
+    }
+    question->any.answer = answer;
+}
+
+void
+PackageInstallJob::progressCallback(
+    void* ctx, alpm_progress_t progress, const char* pkg, int percent, size_t howmany, size_t current )
+{
+    auto* job = static_cast< PackageInstallJob* >( ctx );
+    switch ( progress )
+    {
+    case ALPM_PROGRESS_ADD_START:
+    case ALPM_PROGRESS_UPGRADE_START:
+    case ALPM_PROGRESS_DOWNGRADE_START:
+    case ALPM_PROGRESS_REINSTALL_START:
+        break;
+    default:
+        return;
+    }
+    if ( howmany == 0 || current == 0 )
+    {
+        return;
+    }
+
+    job->m_status = tr( "Installing %1 (%2 of %3)" )
+                        .arg( QString::fromLocal8Bit( pkg ) )
+                        .arg( static_cast< qulonglong >( current ) )
+                        .arg( static_cast< qulonglong >( howmany ) );
+    job->setPhase( Phase::Install, ( qreal( current - 1 ) + percent / 100.0 ) / qreal( howmany ) );
+}
+
+void
+PackageInstallJob::downloadCallback( void* ctx,
+                                     const char* filename,
+                                     alpm_download_event_type_t event,
+                                     void* data )
+{
+    auto* job = static_cast< PackageInstallJob* >( ctx );
+    const QString file = QString::fromLocal8Bit( filename );
+    if ( event == ALPM_DOWNLOAD_COMPLETED && static_cast< alpm_download_event_completed_t* >( data )->result < 0 )
+    {
+        // Databases included, so a failed attempt can say what went missing
+        cWarning() << "de-packages: download failed for" << file;
+        job->m_failedFiles << file;
+        return;
+    }
+    if ( job->m_phase != Phase::Download )
+    {
+        return;
+    }
+
+    qint64 bytes = 0;
+    if ( event == ALPM_DOWNLOAD_PROGRESS )
+    {
+        bytes = static_cast< qint64 >( static_cast< alpm_download_event_progress_t* >( data )->downloaded );
+    }
+    else if ( event == ALPM_DOWNLOAD_COMPLETED )
+    {
+        bytes = static_cast< qint64 >( static_cast< alpm_download_event_completed_t* >( data )->total );
+    }
+    else
+    {
+        return;
+    }
+
+    job->m_downloadedBytes += bytes - job->m_downloaded.value( file, 0 );
+    job->m_downloaded.insert( file, bytes );
+    if ( job->m_downloadTotal > 0 )
+    {
+        job->reportProgress( qreal( job->m_downloadedBytes ) / qreal( job->m_downloadTotal ) );
+    }
+}
@@ -0,0 +1,106 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Installs the packageOperations from GlobalStorage through libalpm.
+ */
+
+#ifndef PACKAGEINSTALLJOB_H
+#define PACKAGEINSTALLJOB_H
+
+#include "Job.h"
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include <alpm.h>
+#include <cstdarg>
+
+class AlpmSession;
+struct DesktopPlan;
+
+class PackageInstallJob : public Calamares::Job
+{
+    Q_OBJECT
+
+public:
+    explicit PackageInstallJob( QObject* parent = nullptr );
+    ~PackageInstallJob() override;
+
+    QString prettyName() const override;
+    QString prettyStatusMessage() const override;
+
+    Calamares::JobResult exec() override;
+
+private:
+    enum class Phase
+    {
+        Sync,
+        Download,
+        Install
+    };
+
+    /// What went wrong, which decides how the next attempt starts
+    enum class Failure
+    {
+        None,
+        Sync,  ///< Refreshing the databases failed
+        NotFound,  ///< A target no repository has; databases may be stale
+        Resolve,  ///< Dependencies missing or conflicting; databases may be stale
+        Fetch,  ///< Some packages could not be downloaded or were corrupt
+        Other,  ///< Worth a plain retry
+        Fatal  ///< Retrying cannot help
+    };
+
+    enum class SyncMode
+    {
+        None,
+        Update,
+        Force
+    };
+
+    struct AttemptResult
+    {
+        bool ok = false;
+        Failure failure = Failure::None;
+        QString message;
+        QString details;
+    };
+
+    AttemptResult installTargets( AlpmSession& session, const QStringList& names, const DesktopPlan* plan );
+    void markAsDependencies( AlpmSession& session, const QStringList& names );
+    void downloadTransaction( AlpmSession& session );
+    void setPhase( Phase phase, qreal fraction );
+    void reportProgress( qreal fraction );
+    void waitForDatabaseLock( const AlpmSession& session ) const;
+
+    static QStringList targetsFromGlobalStorage();
+    static DesktopPlan planFromGlobalStorage( const QStringList& targets );
+    static bool databasesFreshThisSession();
+    static bool completedInEarlierRun( AlpmSession& session, const QStringList& targets );
+    static unsigned long retryDelay( int attempt );
+
+    // libalpm callbacks; ctx is always the job
+    static void logCallback( void* ctx, alpm_loglevel_t level, const char* fmt, va_list args );
+    static void eventCallback( void* ctx, alpm_event_t* event );
+    static void questionCallback( void* ctx, alpm_question_t* question );
+    static void progressCallback(
+        void* ctx, alpm_progress_t progress, const char* pkg, int percent, size_t howmany, size_t current );
+    static void downloadCallback( void* ctx, const char* filename, alpm_download_event_type_t event, void* data );
+
+    Phase m_phase = Phase::Sync;
+    QString m_status;
+    qint64 m_downloadTotal = 0;
+    qint64 m_downloadedBytes = 0;
+    QHash< QString, qint64 > m_downloaded;
+    /// Files libalpm or the downloader failed to fetch in this attempt
+    QStringList m_failedFiles;
+    /// Mirror hosts that failed, in the downloader or in libalpm; skipped
+    /// for the rest of the session
+    QSet< QString > m_badMirrors;
+    /// Hosts of every configured server, to spot in libalpm's messages
+    QSet< QString > m_mirrorHosts;
+};
+
+#endif  // PACKAGEINSTALLJOB_H
@@ -0,0 +1,149 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "PackageListEdit.h"
+
+#include "PackageNameIndex.h"
+
+#include <QAbstractItemView>
+#include <QCompleter>
+#include <QKeyEvent>
+#include <QRegularExpression>
+#include <QScrollBar>
+#include <QStringListModel>
+#include <QTextBlock>
+
+namespace
+{
+/// Shorter prefixes match too much of the repositories to be useful
+constexpr int s_minimumPrefix = 2;
+constexpr int s_maximumCompletions = 50;
+
+const QRegularExpression s_word( QStringLiteral( "\\S+" ) );
+}  // namespace
+
+PackageListEdit::PackageListEdit( PackageNameIndex* index, QWidget* parent )
+    : QPlainTextEdit( parent )
+    , m_index( index )
+    , m_completer( new QCompleter( this ) )
+    , m_completions( new QStringListModel( this ) )
+{
+    m_completer->setModel( m_completions );
+    m_completer->setModelSorting( QCompleter::CaseSensitivelySortedModel );
+    m_completer->setCompletionMode( QCompleter::PopupCompletion );
+    m_completer->setWidget( this );
+    connect( m_completer,
+             qOverload< const QString& >( &QCompleter::activated ),
+             this,
+             &PackageListEdit::insertCompletion );
+
+    connect( this, &QPlainTextEdit::textChanged, this, &PackageListEdit::markUnknownNames );
+    connect( m_index, &PackageNameIndex::ready, this, &PackageListEdit::markUnknownNames );
+}
+
+void
+PackageListEdit::keyPressEvent( QKeyEvent* event )
+{
+    if ( m_completer->popup()->isVisible() )
+    {
+        // The completer acts on these itself
+        switch ( event->key() )
+        {
+        case Qt::Key_Enter:
+        case Qt::Key_Return:
+        case Qt::Key_Escape:
+        case Qt::Key_Tab:
+        case Qt::Key_Backtab:
+            event->ignore();
+            return;
+        default:
+            break;
+        }
+    }
+
+    QPlainTextEdit::keyPressEvent( event );
+    if ( event->text().isEmpty() && event->key() != Qt::Key_Backspace )
+    {
+        // Moving the cursor around is no reason to pop up completions
+        m_completer->popup()->hide();
+        return;
+    }
+    updateCompletions();
+}
+
+void
+PackageListEdit::updateCompletions()
+{
+    const QString prefix = wordBeforeCursor().selectedText();
+    const QStringList completions = prefix.size() < s_minimumPrefix || !m_index->isReady()
+        ? QStringList()
+        : m_index->completions( prefix, s_maximumCompletions );
+    if ( completions.isEmpty() || ( completions.size() == 1 && completions.first() == prefix ) )
+    {
+        m_completer->popup()->hide();
+        return;
+    }
+
+    m_completions->setStringList( completions );
+    m_completer->setCompletionPrefix( prefix );
+    m_completer->popup()->setCurrentIndex( m_completer->completionModel()->index( 0, 0 ) );
+
+    QRect rect = cursorRect();
+    rect.setWidth( m_completer->popup()->sizeHintForColumn( 0 )
+                   + m_completer->popup()->verticalScrollBar()->sizeHint().width() );
+    m_completer->complete( rect );
+}
+
+void
+PackageListEdit::insertCompletion( const QString& completion )
+{
+    QTextCursor cursor = wordBeforeCursor();
+    cursor.insertText( completion + QLatin1Char( ' ' ) );
+    setTextCursor( cursor );
+}
+
+void
+PackageListEdit::markUnknownNames()
+{
+    QList< QTextEdit::ExtraSelection > selections;
+    if ( m_index->isReady() )
+    {
+        QTextCharFormat format;
+        format.setUnderlineStyle( QTextCharFormat::WaveUnderline );
+        format.setUnderlineColor( Qt::red );
+
+        auto match = s_word.globalMatch( toPlainText() );
+        while ( match.hasNext() )
+        {
+            const QRegularExpressionMatch word = match.next();
+            if ( m_index->contains( word.captured() ) )
+            {
+                continue;
+            }
+            QTextEdit::ExtraSelection selection;
+            selection.cursor = QTextCursor( document() );
+            selection.cursor.setPosition( word.capturedStart() );
+            selection.cursor.setPosition( word.capturedEnd(), QTextCursor::KeepAnchor );
+            selection.format = format;
+            selections << selection;
+        }
+    }
+    setExtraSelections( selections );
+}
+
+QTextCursor
+PackageListEdit::wordBeforeCursor() const
+{
+    // Package names contain '-', '.' and '+', which end a word for
+    // QTextCursor::WordUnderCursor
+    QTextCursor cursor = textCursor();
+    const QString text = cursor.block().text();
+    int start = cursor.positionInBlock();
+    while ( start > 0 && !text.at( start - 1 ).isSpace() )
+    {
+        --start;
+    }
+    cursor.setPosition( cursor.block().position() + start, QTextCursor::KeepAnchor );
+    return cursor;
+}
@@ -0,0 +1,39 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * The package list of the custom desktop: completes names from a
+ * PackageNameIndex and underlines the ones no repository has.
+ */
+
+#ifndef PACKAGELISTEDIT_H
+#define PACKAGELISTEDIT_H
+
+#include <QPlainTextEdit>
+#include <QStringList>
+
+class PackageNameIndex;
+class QCompleter;
+class QStringListModel;
+
+class PackageListEdit : public QPlainTextEdit
+{
+    Q_OBJECT
+
+public:
+    PackageListEdit( PackageNameIndex* index, QWidget* parent = nullptr );
+
+protected:
+    void keyPressEvent( QKeyEvent* event ) override;
+
+private:
+    void updateCompletions();
+    void insertCompletion( const QString& completion );
+    void markUnknownNames();
+    QTextCursor wordBeforeCursor() const;
+
+    PackageNameIndex* m_index = nullptr;
+    QCompleter* m_completer = nullptr;
+    QStringListModel* m_completions = nullptr;
+};
+
+#endif  // PACKAGELISTEDIT_H
@@ -0,0 +1,142 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "PackageNameIndex.h"
+
+#include "AlpmSession.h"
+#include "SetupTrace.h"
+
+#include "utils/Logger.h"
+
+#include <QRegularExpression>
+
+#include <algorithm>
+
+namespace
+{
+const QRegularExpression s_constraint( QStringLiteral( "[<>=].*$" ) );
+
+QStringList
+collectNames( AlpmSession& session )
+{
+    QStringList names;
+    for ( alpm_list_t* i = alpm_get_syncdbs( session.handle() ); i; i = alpm_list_next( i ) )
+    {
+        auto* db = static_cast< alpm_db_t* >( i->data );
+        for ( alpm_list_t* p = alpm_db_get_pkgcache( db ); p; p = alpm_list_next( p ) )
+        {
+            auto* pkg = static_cast< alpm_pkg_t* >( p->data );
+            names << QString::fromLocal8Bit( alpm_pkg_get_name( pkg ) );
+            for ( alpm_list_t* d = alpm_pkg_get_provides( pkg ); d; d = alpm_list_next( d ) )
+            {
+                names << QString::fromLocal8Bit( static_cast< alpm_depend_t* >( d->data )->name );
+            }
+        }
+        for ( alpm_list_t* g = alpm_db_get_groupcache( db ); g; g = alpm_list_next( g ) )
+        {
+            names << QString::fromLocal8Bit( static_cast< alpm_group_t* >( g->data )->name );
+        }
+    }
+
+    std::sort( names.begin(), names.end() );
+    names.erase( std::unique( names.begin(), names.end() ), names.end() );
+    return names;
+}
+}  // namespace
+
+PackageNameIndex::PackageNameIndex( QObject* parent )
+    : QObject( parent )
+{
+    m_pool.setMaxThreadCount( 1 );
+}
+
+PackageNameIndex::~PackageNameIndex()
+{
+    m_pool.waitForDone();
+}
+
+void
+PackageNameIndex::load( bool offline, bool reload )
+{
+    if ( isRequested() && offline == m_offline && !reload )
+    {
+        return;
+    }
+
+    // Results of an earlier request are dropped when they arrive
+    const int generation = ++m_generation;
+    m_offline = offline;
+    m_pool.start(
+        [this, offline, generation]()
+        {
+            SetupTrace::Span trace( QStringLiteral( "package-index" ), QStringLiteral( "resolve" ) );
+            AlpmSession session;
+            QStringList names;
+            bool ok = session.initializeForInstall( offline );
+            if ( ok )
+            {
+                names = collectNames( session );
+                ok = !names.isEmpty();
+            }
+            trace.setArg( QStringLiteral( "names" ), int( names.size() ) );
+            if ( !ok )
+            {
+                cWarning() << "de-packages: no package names to check custom packages against"
+                           << session.errorString();
+            }
+
+            QMetaObject::invokeMethod(
+                this,
+                [this, names, ok, generation]()
+                {
+                    if ( generation != m_generation )
+                    {
+                        return;
+                    }
+                    m_names = names;
+                    m_ready = ok;
+                    emit ready();
+                },
+                Qt::QueuedConnection );
+        } );
+}
+
+bool
+PackageNameIndex::contains( const QString& target ) const
+{
+    QString name = target;
+    name.remove( s_constraint );
+    return std::binary_search( m_names.cbegin(), m_names.cend(), name );
+}
+
+QStringList
+PackageNameIndex::unknownNames( const QStringList& targets ) const
+{
+    QStringList unknown;
+    if ( !m_ready )
+    {
+        return unknown;
+    }
+    for ( const QString& target : targets )
+    {
+        if ( !contains( target ) && !unknown.contains( target ) )
+        {
+            unknown << target;
+        }
+    }
+    return unknown;
+}
+
+QStringList
+PackageNameIndex::completions( const QString& prefix, int limit ) const
+{
+    QStringList result;
+    for ( auto it = std::lower_bound( m_names.cbegin(), m_names.cend(), prefix );
+          it != m_names.cend() && it->startsWith( prefix ) && result.size() < limit;
+          ++it )
+    {
+        result << *it;
+    }
+    return result;
+}
@@ -0,0 +1,53 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Every name the sync databases can install: packages, what they
+ * provide, and groups. Built off the UI thread on first use, then
+ * answers lookups and prefix completion with a binary search.
+ */
+
+#ifndef PACKAGENAMEINDEX_H
+#define PACKAGENAMEINDEX_H
+
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+
+class PackageNameIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PackageNameIndex( QObject* parent = nullptr );
+    ~PackageNameIndex() override;
+
+    /** @brief Build the index from the databases of an install session
+     *
+     * Does nothing if the index was already requested for @p offline,
+     * unless @p reload says the databases changed since.
+     */
+    void load( bool offline, bool reload = false );
+
+    bool isRequested() const { return m_generation > 0; }
+    /// False while loading, and if the databases could not be read
+    bool isReady() const { return m_ready; }
+
+    /// Whether @p target, possibly with a version constraint, names anything
+    bool contains( const QString& target ) const;
+    /// The entries of @p targets nothing is known by, once each; empty while not ready
+    QStringList unknownNames( const QStringList& targets ) const;
+    /// Up to @p limit names starting with @p prefix, sorted
+    QStringList completions( const QString& prefix, int limit ) const;
+
+signals:
+    void ready();
+
+private:
+    QThreadPool m_pool;
+    QStringList m_names;
+    bool m_ready = false;
+    bool m_offline = false;
+    int m_generation = 0;
+};
+
+#endif  // PACKAGENAMEINDEX_H
@@ -0,0 +1,339 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "PackagePrefetcher.h"
+#include "DatabaseSync.h"
+#include "PacmanProcess.h"
+#include "SetupTrace.h"
+
+#include "utils/Logger.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+
+#include <signal.h>
+#include <sys/types.h>
+
+namespace
+{
+// Keep the first request after a click from racing the user clicking on.
+constexpr int s_debounceMs = 1500;
+// Give up on a pacman that keeps the database locked after this many
+// debounce periods (about a minute)
+constexpr int s_maxLockRetries = 40;
+
+const QString s_systemCacheDir = QStringLiteral( "/var/cache/pacman/pkg/" );
+const QString s_lockFile = QStringLiteral( "/var/lib/pacman/db.lck" );
+const QString s_partSuffix = QStringLiteral( ".part" );
+}  // namespace
+
+PackagePrefetcher::PackagePrefetcher( QObject* parent )
+    : QObject( parent )
+    , m_debounce( new QTimer( this ) )
+{
+    m_debounce->setSingleShot( true );
+    m_debounce->setInterval( s_debounceMs );
+    connect( m_debounce, &QTimer::timeout, this, [this]() {
+        if ( m_process )
+        {
+            // Restart once the interrupted pacman has released its lock.
+            m_restart = true;
+            interruptProcess();
+            return;
+        }
+        if ( !m_databasesSynced )
+        {
+            // setDatabasesSynced() picks the request up
+            cDebug() << "de-packages: prefetch waits for the package database sync";
+            return;
+        }
+        if ( QFile::exists( s_lockFile ) )
+        {
+            // Another pacman still holds the databases. A lock with no
+            // pacman behind it is stale and stays, so the download could
+            // never take it.
+            if ( !PacmanProcess::running() )
+            {
+                cWarning() << "de-packages: stale" << s_lockFile << "- not prefetching";
+                return;
+            }
+            if ( ++m_lockRetries > s_maxLockRetries )
+            {
+                cWarning() << "de-packages: pacman database stays locked, not prefetching";
+                return;
+            }
+            m_debounce->start();
+            return;
+        }
+        m_lockRetries = 0;
+        startResolve();
+    } );
+}
+
+PackagePrefetcher::~PackagePrefetcher()
+{
+    if ( m_process )
+    {
+        // QProcess would SIGKILL pacman and leave db.lck behind, so give
+        // it a chance to clean up first.
+        m_process->disconnect( this );
+        interruptProcess();
+        if ( !m_process->waitForFinished( 5000 ) )
+        {
+            m_process->kill();
+            m_process->waitForFinished( 1000 );
+        }
+    }
+}
+
+QString
+PackagePrefetcher::cacheDirectory()
+{
+    return QStringLiteral( "/var/cache/calamares-prefetch/" );
+}
+
+void
+PackagePrefetcher::prefetch( const QStringList& packages )
+{
+    if ( packages.isEmpty() )
+    {
+        cancel();
+        return;
+    }
+    if ( packages == m_packages && ( m_stage != Stage::Idle || m_debounce->isActive() ) )
+    {
+        return;
+    }
+
+    m_packages = packages;
+    m_lockRetries = 0;
+    m_debounce->start();
+}
+
+void
+PackagePrefetcher::cancel()
+{
+    m_debounce->stop();
+    m_packages.clear();
+    m_restart = false;
+    if ( m_process )
+    {
+        cDebug() << "de-packages: cancelling package prefetch";
+        interruptProcess();
+    }
+}
+
+void
+PackagePrefetcher::setDatabasesSynced( bool synced )
+{
+    if ( synced == m_databasesSynced )
+    {
+        return;
+    }
+    m_databasesSynced = synced;
+    if ( synced && !m_packages.isEmpty() && m_stage == Stage::Idle && !m_debounce->isActive() )
+    {
+        m_lockRetries = 0;
+        m_debounce->start();
+    }
+}
+
+void
+PackagePrefetcher::startResolve()
+{
+    if ( m_packages.isEmpty() )
+    {
+        m_stage = Stage::Idle;
+        return;
+    }
+
+    // --print never takes the database lock, so this is safe to run
+    // while anything else is using pacman.
+    QStringList args { QStringLiteral( "-Sp" ),
+                       QStringLiteral( "--needed" ),
+                       QStringLiteral( "--noconfirm" ),
+                       QStringLiteral( "--print-format" ),
+                       QStringLiteral( "%f" ) };
+    args << m_packages;
+
+    m_stage = Stage::Resolving;
+    startProcess( QStringLiteral( "pacman" ), args );
+}
+
+void
+PackagePrefetcher::startDownload()
+{
+    if ( !QDir().mkpath( cacheDirectory() ) )
+    {
+        cWarning() << "de-packages: cannot create prefetch cache" << cacheDirectory();
+        m_stage = Stage::Idle;
+        return;
+    }
+
+    // The prefetch directory comes first so new files land there; the
+    // system cache is still consulted for packages that are already local.
+    QStringList args { QStringLiteral( "-c" ),
+                       QStringLiteral( "3" ),
+                       QStringLiteral( "nice" ),
+                       QStringLiteral( "-n" ),
+                       QStringLiteral( "19" ),
+                       QStringLiteral( "pacman" ),
+                       QStringLiteral( "-Sw" ),
+                       QStringLiteral( "--needed" ),
+                       QStringLiteral( "--noconfirm" ),
+                       QStringLiteral( "--disable-download-timeout" ),
+                       QStringLiteral( "--cachedir" ),
+                       cacheDirectory(),
+                       QStringLiteral( "--cachedir" ),
+                       s_systemCacheDir };
+    // The mirrors the database sync ranked and used
+    if ( QFile::exists( DatabaseSync::configFile() ) )
+    {
+        args << QStringLiteral( "--config" ) << DatabaseSync::configFile();
+    }
+    args << m_packages;
+
+    cDebug() << "de-packages: prefetching" << m_packages.count() << "targets into" << cacheDirectory();
+
+    m_stage = Stage::Downloading;
+    startProcess( QStringLiteral( "ionice" ), args );
+}
+
+void
+PackagePrefetcher::startProcess( const QString& program, const QStringList& args )
+{
+    m_stageStart = SetupTrace::now();
+    m_process = new QProcess( this );
+    connect( m_process,
+             QOverload< int, QProcess::ExitStatus >::of( &QProcess::finished ),
+             this,
+             &PackagePrefetcher::onProcessFinished );
+    connect( m_process, &QProcess::errorOccurred, this, [this]( QProcess::ProcessError error ) {
+        if ( error == QProcess::FailedToStart )
+        {
+            cWarning() << "de-packages: could not start prefetch process" << m_process->errorString();
+            onProcessFinished( -1, QProcess::CrashExit );
+        }
+    } );
+    m_process->start( program, args );
+}
+
+void
+PackagePrefetcher::onProcessFinished( int exitCode, QProcess::ExitStatus exitStatus )
+{
+    QProcess* process = m_process;
+    m_process = nullptr;
+    const Stage stage = m_stage;
+    m_stage = Stage::Idle;
+
+    const bool ok = ( exitStatus == QProcess::NormalExit ) && ( exitCode == 0 );
+    const QByteArray output = process ? process->readAllStandardOutput() : QByteArray();
+    if ( process )
+    {
+        process->deleteLater();
+    }
+
+    if ( m_restart )
+    {
+        m_restart = false;
+        startResolve();
+        return;
+    }
+
+    if ( stage == Stage::Resolving )
+    {
+        if ( m_packages.isEmpty() )
+        {
+            return;
+        }
+        if ( !ok )
+        {
+            cWarning() << "de-packages: could not resolve prefetch targets, exit code" << exitCode;
+            return;
+        }
+
+        QSet< QString > closure;
+        const auto lines = output.split( '\n' );
+        for ( const QByteArray& line : lines )
+        {
+            const QString file = QString::fromUtf8( line ).trimmed();
+            if ( file.contains( QStringLiteral( ".pkg.tar" ) ) )
+            {
+                closure.insert( file );
+            }
+        }
+
+        pruneCache( closure );
+        if ( closure.isEmpty() )
+        {
+            cDebug() << "de-packages: nothing to prefetch";
+            return;
+        }
+        startDownload();
+    }
+    else if ( stage == Stage::Downloading )
+    {
+        SetupTrace::complete( QStringLiteral( "prefetch" ),
+                              QStringLiteral( "download" ),
+                              m_stageStart,
+                              { { QStringLiteral( "targets" ), m_packages.count() }, { QStringLiteral( "ok" ), ok } } );
+        if ( ok )
+        {
+            cDebug() << "de-packages: package prefetch complete";
+        }
+        else
+        {
+            cDebug() << "de-packages: package prefetch stopped, exit code" << exitCode;
+        }
+    }
+}
+
+void
+PackagePrefetcher::pruneCache( const QSet< QString >& keep ) const
+{
+    QDir dir( cacheDirectory() );
+    if ( !dir.exists() )
+    {
+        return;
+    }
+
+    const auto entries = dir.entryInfoList( QDir::Files | QDir::NoDotAndDotDot );
+    int removed = 0;
+    for ( const QFileInfo& entry : entries )
+    {
+        QString name = entry.fileName();
+        if ( name.endsWith( s_partSuffix ) )
+        {
+            name.chop( s_partSuffix.length() );
+        }
+        if ( !keep.contains( name ) && QFile::remove( entry.absoluteFilePath() ) )
+        {
+            ++removed;
+        }
+    }
+
+    if ( removed )
+    {
+        cDebug() << "de-packages: dropped" << removed << "prefetched files no longer needed";
+    }
+}
+
+void
+PackagePrefetcher::interruptProcess()
+{
+    if ( !m_process || m_process->state() == QProcess::NotRunning )
+    {
+        return;
+    }
+
+    // pacman only releases its lock and temporary files on SIGINT; both
+    // ionice and nice exec() it, so the child pid is pacman itself.
+    const qint64 pid = m_process->processId();
+    if ( pid > 0 )
+    {
+        ::kill( static_cast< pid_t >( pid ), SIGINT );
+    }
+}
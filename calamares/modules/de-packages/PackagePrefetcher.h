@@ -0,0 +1,73 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Background download of a desktop's package closure into a private
+ * pacman cache directory while the remaining pages are filled in.
+ */
+
+#ifndef PACKAGEPREFETCHER_H
+#define PACKAGEPREFETCHER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QSet>
+#include <QStringList>
+
+class QTimer;
+
+class PackagePrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PackagePrefetcher( QObject* parent = nullptr );
+    ~PackagePrefetcher() override;
+
+    /** @brief Start (or retarget) the prefetch for @p packages
+     *
+     * Requests are debounced, so clicking through several cards only
+     * starts one download. Files already fetched for a previous request
+     * are kept when the new closure still needs them.
+     */
+    void prefetch( const QStringList& packages );
+    /// Stop any running download and forget the current request.
+    void cancel();
+    /** @brief Let requests run once the background database sync is done
+     *
+     * Until then a request only waits: resolving against the old
+     * databases fetches the wrong files, the download would race the
+     * sync for the database lock, and the ranked mirrors are not known.
+     */
+    void setDatabasesSynced( bool synced );
+
+    /// Cache directory the prefetched packages are written to.
+    static QString cacheDirectory();
+
+private:
+    enum class Stage
+    {
+        Idle,
+        Resolving,
+        Downloading
+    };
+
+    void startResolve();
+    void startDownload();
+    void startProcess( const QString& program, const QStringList& args );
+    void onProcessFinished( int exitCode, QProcess::ExitStatus exitStatus );
+    void pruneCache( const QSet< QString >& keep ) const;
+    void interruptProcess();
+
+    QTimer* m_debounce = nullptr;
+    QProcess* m_process = nullptr;
+    QStringList m_packages;
+    Stage m_stage = Stage::Idle;
+    /// SetupTrace::now() when the running stage began
+    qint64 m_stageStart = 0;
+    bool m_restart = false;
+    bool m_databasesSynced = false;
+    /// Debounce periods spent waiting for another pacman's lock
+    int m_lockRetries = 0;
+};
+
+#endif  // PACKAGEPREFETCHER_H
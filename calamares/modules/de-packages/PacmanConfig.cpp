@@ -0,0 +1,357 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "PacmanConfig.h"
+#include "LocalRepository.h"
+
+#include "utils/Logger.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include <alpm.h>
+#include <sys/utsname.h>
+
+namespace
+{
+constexpr int s_defaultSigLevel
+    = ALPM_SIG_PACKAGE | ALPM_SIG_PACKAGE_OPTIONAL | ALPM_SIG_DATABASE | ALPM_SIG_DATABASE_OPTIONAL;
+
+// Written by the networksetup module once it has probed the mirrors
+const QString s_mirrorlist = QStringLiteral( "/etc/pacman.d/mirrorlist" );
+const QString s_rankedMirrorlist = QStringLiteral( "/tmp/calamares-mirrorlist" );
+
+// Same rules as pacman's process_siglevel(), minus the bookkeeping it
+// needs to merge partially specified repository levels.
+int
+parseSigLevel( const QStringList& tokens, int level )
+{
+    for ( QString token : tokens )
+    {
+        bool package = true;
+        bool database = true;
+        if ( token.startsWith( QStringLiteral( "Package" ) ) )
+        {
+            database = false;
+            token.remove( 0, 7 );
+        }
+        else if ( token.startsWith( QStringLiteral( "Database" ) ) )
+        {
+            package = false;
+            token.remove( 0, 8 );
+        }
+
+        int sig = 0;
+        int optional = 0;
+        int trust = 0;
+        if ( package )
+        {
+            sig |= ALPM_SIG_PACKAGE;
+            optional |= ALPM_SIG_PACKAGE_OPTIONAL;
+            trust |= ALPM_SIG_PACKAGE_MARGINAL_OK | ALPM_SIG_PACKAGE_UNKNOWN_OK;
+        }
+        if ( database )
+        {
+            sig |= ALPM_SIG_DATABASE;
+            optional |= ALPM_SIG_DATABASE_OPTIONAL;
+            trust |= ALPM_SIG_DATABASE_MARGINAL_OK | ALPM_SIG_DATABASE_UNKNOWN_OK;
+        }
+
+        if ( token == QStringLiteral( "Never" ) )
+        {
+            level &= ~sig;
+        }
+        else if ( token == QStringLiteral( "Optional" ) )
+        {
+            level |= sig | optional;
+        }
+        else if ( token == QStringLiteral( "Required" ) )
+        {
+            level |= sig;
+            level &= ~optional;
+        }
+        else if ( token == QStringLiteral( "TrustedOnly" ) )
+        {
+            level &= ~trust;
+        }
+        else if ( token == QStringLiteral( "TrustAll" ) )
+        {
+            level |= trust;
+        }
+        else
+        {
+            cWarning() << "de-packages: unknown SigLevel token" << token;
+        }
+    }
+    return level;
+}
+
+QString
+machineArchitecture()
+{
+    struct utsname un;
+    if ( uname( &un ) == 0 )
+    {
+        return QString::fromLatin1( un.machine );
+    }
+    return QStringLiteral( "aarch64" );
+}
+
+QString
+withTrailingSlash( const QString& path )
+{
+    return path.endsWith( QLatin1Char( '/' ) ) ? path : path + QLatin1Char( '/' );
+}
+
+struct ParseState
+{
+    PacmanConfig* config = nullptr;
+    QString section;
+    QStringList repoSigLevel;
+    int depth = 0;
+};
+
+void parseFile( const QString& path, ParseState& state );
+
+void
+includeFiles( const QString& pattern, ParseState& state )
+{
+    const QFileInfo info( pattern );
+    if ( !pattern.contains( QLatin1Char( '*' ) ) )
+    {
+        const bool ranked = pattern == s_mirrorlist && QFileInfo::exists( s_rankedMirrorlist );
+        parseFile( ranked ? s_rankedMirrorlist : pattern, state );
+        return;
+    }
+
+    const QDir dir = info.dir();
+    const auto files = dir.entryList( QStringList { info.fileName() }, QDir::Files, QDir::Name );
+    for ( const QString& file : files )
+    {
+        parseFile( dir.filePath( file ), state );
+    }
+}
+
+void
+finishRepository( ParseState& state )
+{
+    if ( state.section.isEmpty() || state.section == QStringLiteral( "options" ) )
+    {
+        return;
+    }
+    auto& repo = state.config->repositories.last();
+    repo.sigLevel = parseSigLevel( state.repoSigLevel, state.config->sigLevel );
+}
+
+void
+parseFile( const QString& path, ParseState& state )
+{
+    if ( ++state.depth > 10 )
+    {
+        cWarning() << "de-packages: pacman.conf includes nested too deeply at" << path;
+        --state.depth;
+        return;
+    }
+
+    QFile file( path );
+    if ( !file.open( QIODevice::ReadOnly | QIODevice::Text ) )
+    {
+        cWarning() << "de-packages: cannot read" << path << file.errorString();
+        --state.depth;
+        return;
+    }
+
+    PacmanConfig& config = *state.config;
+    QTextStream in( &file );
+    while ( !in.atEnd() )
+    {
+        QString line = in.readLine();
+        const int comment = line.indexOf( QLatin1Char( '#' ) );
+        if ( comment >= 0 )
+        {
+            line.truncate( comment );
+        }
+        line = line.trimmed();
+        if ( line.isEmpty() )
+        {
+            continue;
+        }
+
+        if ( line.startsWith( QLatin1Char( '[' ) ) && line.endsWith( QLatin1Char( ']' ) ) )
+        {
+            finishRepository( state );
+            state.section = line.mid( 1, line.length() - 2 );
+            state.repoSigLevel.clear();
+            if ( state.section != QStringLiteral( "options" ) )
+            {
+                PacmanRepository repo;
+                repo.name = state.section;
+                config.repositories.append( repo );
+            }
+            continue;
+        }
+
+        const int eq = line.indexOf( QLatin1Char( '=' ) );
+        const QString key = ( eq < 0 ? line : line.left( eq ) ).trimmed();
+        const QString value = eq < 0 ? QString() : line.mid( eq + 1 ).trimmed();
+        const QStringList values = value.split( QLatin1Char( ' ' ), Qt::SkipEmptyParts );
+
+        if ( key == QStringLiteral( "Include" ) )
+        {
+            includeFiles( value, state );
+        }
+        else if ( state.section == QStringLiteral( "options" ) )
+        {
+            if ( key == QStringLiteral( "RootDir" ) )
+            {
+                config.rootDir = withTrailingSlash( value );
+            }
+            else if ( key == QStringLiteral( "DBPath" ) )
+            {
+                config.dbPath = withTrailingSlash( value );
+            }
+            else if ( key == QStringLiteral( "GPGDir" ) )
+            {
+                config.gpgDir = withTrailingSlash( value );
+            }
+            else if ( key == QStringLiteral( "LogFile" ) )
+            {
+                config.logFile = value;
+            }
+            else if ( key == QStringLiteral( "CacheDir" ) )
+            {
+                for ( const QString& dir : values )
+                {
+                    config.cacheDirs.append( withTrailingSlash( dir ) );
+                }
+            }
+            else if ( key == QStringLiteral( "HookDir" ) )
+            {
+                for ( const QString& dir : values )
+                {
+                    config.hookDirs.append( withTrailingSlash( dir ) );
+                }
+            }
+            else if ( key == QStringLiteral( "Architecture" ) )
+            {
+                for ( const QString& arch : values )
+                {
+                    config.architectures.append( arch == QStringLiteral( "auto" ) ? machineArchitecture() : arch );
+                }
+            }
+            else if ( key == QStringLiteral( "IgnorePkg" ) )
+            {
+                config.ignorePackages << values;
+            }
+            else if ( key == QStringLiteral( "IgnoreGroup" ) )
+            {
+                config.ignoreGroups << values;
+            }
+            else if ( key == QStringLiteral( "NoUpgrade" ) )
+            {
+                config.noUpgrade << values;
+            }
+            else if ( key == QStringLiteral( "NoExtract" ) )
+            {
+                config.noExtract << values;
+            }
+            else if ( key == QStringLiteral( "SigLevel" ) )
+            {
+                config.sigLevel = parseSigLevel( values, s_defaultSigLevel );
+            }
+            else if ( key == QStringLiteral( "ParallelDownloads" ) )
+            {
+                config.parallelDownloads = qMax( 1, value.toInt() );
+            }
+            else if ( key == QStringLiteral( "CheckSpace" ) )
+            {
+                config.checkSpace = true;
+            }
+        }
+        else if ( !state.section.isEmpty() )
+        {
+            if ( key == QStringLiteral( "Server" ) )
+            {
+                config.repositories.last().servers.append( value );
+            }
+            else if ( key == QStringLiteral( "SigLevel" ) )
+            {
+                state.repoSigLevel << values;
+            }
+        }
+    }
+
+    --state.depth;
+}
+}  // namespace
+
+PacmanConfig
+PacmanConfig::load( const QString& path )
+{
+    PacmanConfig config;
+    config.sigLevel = s_defaultSigLevel;
+
+    ParseState state;
+    state.config = &config;
+    parseFile( path, state );
+    finishRepository( state );
+
+    if ( config.cacheDirs.isEmpty() )
+    {
+        config.cacheDirs.append( QStringLiteral( "/var/cache/pacman/pkg/" ) );
+    }
+    // pacman always runs the system hooks first, then HookDir
+    config.hookDirs.prepend( QStringLiteral( "/usr/share/libalpm/hooks/" ) );
+    if ( config.hookDirs.count() == 1 )
+    {
+        config.hookDirs.append( QStringLiteral( "/etc/pacman.d/hooks/" ) );
+    }
+    if ( config.architectures.isEmpty() )
+    {
+        config.architectures.append( machineArchitecture() );
+    }
+
+    const QString arch = config.architectures.first();
+    for ( auto& repo : config.repositories )
+    {
+        for ( QString& server : repo.servers )
+        {
+            server.replace( QStringLiteral( "$repo" ), repo.name );
+            server.replace( QStringLiteral( "$arch" ), arch );
+        }
+    }
+
+    return config;
+}
+
+QString
+PacmanConfig::lockFile() const
+{
+    return dbPath + QStringLiteral( "db.lck" );
+}
+
+QString
+PacmanConfig::localRepositoryPath()
+{
+    return LocalRepository::path();
+}
+
+bool
+PacmanConfig::hasLocalRepository()
+{
+    return LocalRepository::exists();
+}
+
+PacmanRepository
+PacmanConfig::localRepository()
+{
+    PacmanRepository repo;
+    repo.name = LocalRepository::name();
+    repo.servers << QStringLiteral( "file://" ) + LocalRepository::path().chopped( 1 );
+    // The media is trusted as a whole; check signatures only where present
+    repo.sigLevel = ALPM_SIG_PACKAGE | ALPM_SIG_PACKAGE_OPTIONAL | ALPM_SIG_DATABASE | ALPM_SIG_DATABASE_OPTIONAL;
+    return repo;
+}
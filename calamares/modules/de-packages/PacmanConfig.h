@@ -0,0 +1,57 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Minimal pacman.conf reader, covering the options libalpm needs to
+ * run a sync transaction the same way pacman would.
+ */
+
+#ifndef PACMANCONFIG_H
+#define PACMANCONFIG_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+struct PacmanRepository
+{
+    QString name;
+    QStringList servers;
+    int sigLevel = 0;
+};
+
+struct PacmanConfig
+{
+    QString rootDir = QStringLiteral( "/" );
+    QString dbPath = QStringLiteral( "/var/lib/pacman/" );
+    QString gpgDir = QStringLiteral( "/etc/pacman.d/gnupg/" );
+    QString logFile = QStringLiteral( "/var/log/pacman.log" );
+    QStringList cacheDirs;
+    QStringList hookDirs;
+    QStringList architectures;
+    QStringList ignorePackages;
+    QStringList ignoreGroups;
+    QStringList noUpgrade;
+    QStringList noExtract;
+    int sigLevel = 0;
+    int parallelDownloads = 1;
+    bool checkSpace = false;
+    QVector< PacmanRepository > repositories;
+
+    /** @brief Parse @p path, following Include directives
+     *
+     * Unknown options are ignored; missing defaults (cache and hook
+     * directories, architecture) are filled in as pacman does.
+     */
+    static PacmanConfig load( const QString& path = QStringLiteral( "/etc/pacman.conf" ) );
+
+    /// Path of the database lock file for this configuration.
+    QString lockFile() const;
+
+    /// Directory of the package repository shipped on the install media
+    static QString localRepositoryPath();
+    static bool hasLocalRepository();
+    /// The on-media repository as a sync repository (file:// server)
+    static PacmanRepository localRepository();
+};
+
+#endif  // PACMANCONFIG_H
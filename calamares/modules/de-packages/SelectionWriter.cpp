@@ -0,0 +1,67 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "SelectionWriter.h"
+
+#include "utils/Logger.h"
+
+#include <QMutexLocker>
+#include <QSaveFile>
+
+SelectionWriter::SelectionWriter()
+{
+    m_pool.setMaxThreadCount( 1 );
+}
+
+SelectionWriter::~SelectionWriter()
+{
+    flush();
+}
+
+void
+SelectionWriter::write( const QString& path, const QByteArray& contents )
+{
+    QMutexLocker locker( &m_mutex );
+    m_pending.insert( path, contents );
+    if ( !m_scheduled )
+    {
+        m_scheduled = true;
+        m_pool.start( [this]() { drain(); } );
+    }
+}
+
+void
+SelectionWriter::flush()
+{
+    m_pool.waitForDone();
+}
+
+void
+SelectionWriter::drain()
+{
+    for ( ;; )
+    {
+        QHash< QString, QByteArray > pending;
+        {
+            QMutexLocker locker( &m_mutex );
+            pending.swap( m_pending );
+            if ( pending.isEmpty() )
+            {
+                m_scheduled = false;
+                return;
+            }
+        }
+
+        for ( auto it = pending.constBegin(); it != pending.constEnd(); ++it )
+        {
+            // QSaveFile writes next to the target and renames over it
+            QSaveFile file( it.key() );
+            if ( !file.open( QIODevice::WriteOnly ) || file.write( it.value() ) != it.value().size()
+                 || !file.commit() )
+            {
+                cWarning() << "de-packages: could not write" << it.key() << file.errorString();
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Writes the selection files in /tmp that the shell steps read, off the
+ * UI thread. Each file is replaced atomically, so a reader sees either
+ * the old or the new contents, never a torn one.
+ */
+
+#ifndef SELECTIONWRITER_H
+#define SELECTIONWRITER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+class SelectionWriter
+{
+public:
+    SelectionWriter();
+    ~SelectionWriter();
+
+    /** @brief Replace the contents of @p path in the background
+     *
+     * Writes that have not started yet are coalesced, so only the last
+     * contents queued for a file are written.
+     */
+    void write( const QString& path, const QByteArray& contents );
+
+    /// Block until everything queued so far is on disk
+    void flush();
+
+private:
+    void drain();
+
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QHash< QString, QByteArray > m_pending;
+    bool m_scheduled = false;
+};
+
+#endif  // SELECTIONWRITER_H
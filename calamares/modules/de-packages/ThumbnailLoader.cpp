@@ -0,0 +1,142 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "ThumbnailLoader.h"
+
+#include "utils/Logger.h"
+
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+#include <QThread>
+
+namespace
+{
+/// Bound on the decoded thumbnails kept, in KiB
+constexpr int s_cacheLimit = 16 * 1024;
+
+QImage
+decode( const QStringList& candidates, const QSize& size, qreal dpr )
+{
+    for ( const QString& path : candidates )
+    {
+        QImageReader reader( path );
+        reader.setAutoTransform( true );
+        const QSize source = reader.size();
+        if ( !source.isValid() )
+        {
+            continue;
+        }
+
+        // Decoders that support it never materialize the full image; the
+        // others still scale here rather than on the UI thread. Small
+        // images are scaled up, so every card shows the same size.
+        const QSize target = source.scaled( size * dpr, Qt::KeepAspectRatio );
+        if ( target != source )
+        {
+            reader.setScaledSize( target );
+        }
+        QImage image = reader.read();
+        if ( image.isNull() )
+        {
+            cWarning() << "de-packages: could not decode" << path << reader.errorString();
+            continue;
+        }
+        image.setDevicePixelRatio( dpr );
+        return image;
+    }
+    return QImage();
+}
+}  // namespace
+
+ThumbnailLoader::ThumbnailLoader( QObject* parent )
+    : QObject( parent )
+    , m_cache( s_cacheLimit )
+{
+    m_pool.setMaxThreadCount( qBound( 1, QThread::idealThreadCount() / 2, 4 ) );
+}
+
+ThumbnailLoader::~ThumbnailLoader()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+QString
+ThumbnailLoader::cacheKey( const QStringList& candidates, const QSize& size, qreal dpr )
+{
+    return QStringLiteral( "%1|%2x%3@%4" )
+        .arg( candidates.join( QLatin1Char( ':' ) ) )
+        .arg( size.width() )
+        .arg( size.height() )
+        .arg( dpr );
+}
+
+QPixmap
+ThumbnailLoader::thumbnail( const QStringList& candidates, const QSize& size, qreal dpr )
+{
+    const QString key = cacheKey( candidates, size, dpr );
+    if ( const QPixmap* cached = m_cache.object( key ) )
+    {
+        return *cached;
+    }
+    if ( m_pending.contains( key ) || m_failed.contains( key ) )
+    {
+        return QPixmap();
+    }
+
+    // Pre-rendered thumbnails compiled into the plugin are tiny and
+    // already the right size, so they are not worth a round trip
+    if ( candidates.value( 0 ).startsWith( QLatin1String( ":/" ) ) && QFile::exists( candidates.first() ) )
+    {
+        QPixmap prebuilt( candidates.first() );
+        if ( !prebuilt.isNull() )
+        {
+            prebuilt.setDevicePixelRatio( dpr );
+            m_cache.insert(
+                key, new QPixmap( prebuilt ), qMax( 1, prebuilt.width() * prebuilt.height() * 4 / 1024 ) );
+            return prebuilt;
+        }
+    }
+
+    m_pending.insert( key );
+    m_pool.start(
+        [this, key, candidates, size, dpr]()
+        {
+            const QImage image = decode( candidates, size, dpr );
+            QMetaObject::invokeMethod(
+                this,
+                [this, key, candidates, image]()
+                {
+                    m_pending.remove( key );
+                    if ( image.isNull() )
+                    {
+                        m_failed.insert( key );
+                    }
+                    else
+                    {
+                        // Pixmaps can only be created on the UI thread
+                        auto* pixmap = new QPixmap( QPixmap::fromImage( image ) );
+                        m_cache.insert( key, pixmap, qMax( qsizetype( 1 ), image.sizeInBytes() / 1024 ) );
+                    }
+                    emit loaded( candidates );
+                },
+                Qt::QueuedConnection );
+        } );
+    return QPixmap();
+}
+
+bool
+ThumbnailLoader::hasFailed( const QStringList& candidates ) const
+{
+    const QString prefix = candidates.join( QLatin1Char( ':' ) ) + QLatin1Char( '|' );
+    for ( const QString& key : m_failed )
+    {
+        if ( key.startsWith( prefix ) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
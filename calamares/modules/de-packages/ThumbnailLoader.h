@@ -0,0 +1,52 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Decodes the desktop screenshots off the UI thread, straight to the
+ * size and device pixel ratio of the card showing them.
+ */
+
+#ifndef THUMBNAILLOADER_H
+#define THUMBNAILLOADER_H
+
+#include <QCache>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QSize>
+#include <QStringList>
+#include <QThreadPool>
+
+class ThumbnailLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailLoader( QObject* parent = nullptr );
+    ~ThumbnailLoader() override;
+
+    /** @brief The first readable image of @p candidates, fit into @p size
+     *
+     * Returns the cached pixmap, or a null one while the image is decoded
+     * in the background; loaded() follows once it is available. @p size
+     * is in device-independent pixels. A first candidate in the plugin's
+     * resources (":/...") is taken as already having that size.
+     */
+    QPixmap thumbnail( const QStringList& candidates, const QSize& size, qreal dpr );
+
+    /// None of @p candidates could be read
+    bool hasFailed( const QStringList& candidates ) const;
+
+signals:
+    void loaded( const QStringList& candidates );
+
+private:
+    static QString cacheKey( const QStringList& candidates, const QSize& size, qreal dpr );
+
+    /// Owned here rather than static: pixmaps must not outlive QApplication
+    QCache< QString, QPixmap > m_cache;
+    QThreadPool m_pool;
+    QSet< QString > m_pending;
+    QSet< QString > m_failed;
+};
+
+#endif  // THUMBNAILLOADER_H
@@ -0,0 +1,238 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "MirrorRanker.h"
+
+#include "SetupTrace.h"
+
+#include "utils/Logger.h"
+
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QTimer>
+#include <QUrl>
+
+#include <algorithm>
+
+#include <sys/utsname.h>
+
+// Mirrors probed at the same time
+constexpr int MAX_PARALLEL_PROBES = 6;
+// A mirror that cannot deliver the probe range in this time is not worth using
+constexpr int PROBE_TIMEOUT_MS = 5000;
+// The probe fetches the start of core.db, which every mirror carries
+constexpr const char* PROBE_RANGE = "bytes=0-262143";
+constexpr const char* PROBE_REPO = "core";
+
+static QString
+machineArchitecture()
+{
+    struct utsname un;
+    if (uname(&un) == 0)
+        return QString::fromLatin1(un.machine);
+    return QStringLiteral("aarch64");
+}
+
+MirrorRanker::MirrorRanker(QObject* parent)
+    : QObject(parent)
+    , m_network(new QNetworkAccessManager(this))
+{
+}
+
+MirrorRanker::~MirrorRanker()
+{
+    // Aborting emits finished() on each reply; nobody is listening anymore
+    m_network->disconnect(this);
+    const auto replies = m_network->findChildren<QNetworkReply*>();
+    for (QNetworkReply* reply : replies)
+    {
+        reply->disconnect(this);
+        reply->abort();
+    }
+}
+
+QString
+MirrorRanker::mirrorlist()
+{
+    return QStringLiteral("/etc/pacman.d/mirrorlist");
+}
+
+QString
+MirrorRanker::rankedMirrorlist()
+{
+    return QStringLiteral("/tmp/calamares-mirrorlist");
+}
+
+void
+MirrorRanker::start()
+{
+    if (m_running || m_done)
+        return;
+
+    QFile file(mirrorlist());
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        cWarning() << "NetworkSetup: cannot read" << mirrorlist() << file.errorString();
+        emit finished(false);
+        return;
+    }
+
+    // Only the servers in use are ranked, as rankmirrors does; commented-out
+    // ones were left out by the distribution or the admin
+    static const QRegularExpression serverLine(QStringLiteral("^Server\\s*=\\s*(\\S+)"));
+    QStringList servers;
+    QTextStream in(&file);
+    while (!in.atEnd())
+    {
+        const auto match = serverLine.match(in.readLine().trimmed());
+        if (match.hasMatch() && !servers.contains(match.captured(1)))
+            servers << match.captured(1);
+    }
+
+    m_probes.clear();
+    for (const QString& server : std::as_const(servers))
+    {
+        Probe probe;
+        probe.server = server;
+        m_probes.append(probe);
+    }
+
+    if (m_probes.size() < 2)
+    {
+        cDebug() << "NetworkSetup: only" << m_probes.size() << "mirror(s) configured, nothing to rank";
+        m_done = true;
+        emit finished(false);
+        return;
+    }
+
+    cDebug() << "NetworkSetup: probing" << m_probes.size() << "mirrors";
+    m_running = true;
+    m_startTime = SetupTrace::now();
+    m_nextProbe = 0;
+    m_activeProbes = 0;
+    startNextProbes();
+}
+
+void
+MirrorRanker::startNextProbes()
+{
+    const QString arch = machineArchitecture();
+    while (m_activeProbes < MAX_PARALLEL_PROBES && m_nextProbe < m_probes.size())
+    {
+        const int index = m_nextProbe++;
+        Probe& probe = m_probes[index];
+
+        QString base = probe.server;
+        base.replace(QStringLiteral("$repo"), QLatin1String(PROBE_REPO));
+        base.replace(QStringLiteral("$arch"), arch);
+        QNetworkRequest request(QUrl(base + QStringLiteral("/%1.db").arg(QLatin1String(PROBE_REPO))));
+        request.setRawHeader("Range", PROBE_RANGE);
+
+        ++m_activeProbes;
+        probe.timer.start();
+        QNetworkReply* reply = m_network->get(request);
+        connect(reply, &QNetworkReply::readyRead, this, [this, index, reply]() {
+            Probe& p = m_probes[index];
+            if (p.latency < 0)
+                p.latency = p.timer.elapsed();
+            p.bytes += reply->readAll().size();
+        });
+        connect(reply, &QNetworkReply::finished, this, [this, index, reply]() {
+            onProbeFinished(index, reply);
+        });
+        // A deadline for the whole probe; a transfer timeout would let a
+        // mirror that keeps trickling bytes hold its slot indefinitely
+        QTimer::singleShot(PROBE_TIMEOUT_MS, reply, [reply]() { reply->abort(); });
+    }
+}
+
+void
+MirrorRanker::onProbeFinished(int index, QNetworkReply* reply)
+{
+    Probe& probe = m_probes[index];
+    probe.bytes += reply->readAll().size();
+    probe.elapsed = probe.timer.elapsed();
+    probe.ok = reply->error() == QNetworkReply::NoError && probe.bytes > 0;
+
+    if (probe.ok)
+        cDebug() << "NetworkSetup: mirror" << probe.server << "latency" << probe.latency << "ms,"
+                 << probe.throughput() / 1024 << "KiB/s";
+    else
+        cDebug() << "NetworkSetup: mirror" << probe.server << "failed:" << reply->errorString();
+
+    reply->deleteLater();
+    --m_activeProbes;
+    startNextProbes();
+    if (m_activeProbes == 0 && m_nextProbe >= m_probes.size())
+        finish();
+}
+
+void
+MirrorRanker::finish()
+{
+    m_running = false;
+    m_done = true;
+
+    QVector<Probe> ranked;
+    QStringList failed;
+    for (const Probe& probe : m_probes)
+    {
+        if (probe.ok)
+            ranked.append(probe);
+        else
+            failed << probe.server;
+    }
+
+    SetupTrace::complete(QStringLiteral("mirror-ranking"), QStringLiteral("network"), m_startTime,
+                         { { QStringLiteral("mirrors"), int(m_probes.size()) },
+                           { QStringLiteral("answered"), int(ranked.size()) } });
+
+    // Time to fetch the whole range covers both latency and throughput
+    std::stable_sort(ranked.begin(), ranked.end(), [](const Probe& a, const Probe& b) {
+        return a.throughput() > b.throughput();
+    });
+
+    if (ranked.isEmpty())
+    {
+        cWarning() << "NetworkSetup: no mirror answered, keeping the default mirror order";
+        emit finished(false);
+        return;
+    }
+
+    m_bestThroughput = ranked.first().throughput();
+    emit finished(writeRankedList(ranked, failed));
+}
+
+bool
+MirrorRanker::writeRankedList(const QVector<Probe>& ranked, const QStringList& failed)
+{
+    QSaveFile file(rankedMirrorlist());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        cWarning() << "NetworkSetup: could not write" << rankedMirrorlist() << file.errorString();
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "# Generated by the installer from " << mirrorlist() << ", fastest first\n";
+    for (const Probe& probe : ranked)
+        out << "Server = " << probe.server << "\n";
+    // Unreachable or too slow during the probe, but still configured
+    for (const QString& server : failed)
+        out << "Server = " << server << "\n";
+    out.flush();
+
+    if (!file.commit())
+    {
+        cWarning() << "NetworkSetup: could not write" << rankedMirrorlist() << file.errorString();
+        return false;
+    }
+    cDebug() << "NetworkSetup: fastest mirror is" << ranked.first().server;
+    return true;
+}
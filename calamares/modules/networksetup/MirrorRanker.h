@@ -0,0 +1,70 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Probes the mirrors from pacman's mirrorlist in parallel and writes a
+ * copy ordered by measured speed for the install transaction to use.
+ */
+
+#ifndef MIRRORRANKER_H
+#define MIRRORRANKER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+class MirrorRanker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MirrorRanker(QObject* parent = nullptr);
+    ~MirrorRanker() override;
+
+    // Probe the mirrors unless that is running or already done this session
+    void start();
+
+    bool isRunning() const { return m_running; }
+
+    // Bytes per second of the fastest mirror, 0 if nothing was measured
+    qint64 bestThroughput() const { return m_bestThroughput; }
+
+    static QString mirrorlist();
+    // Ranked copy of mirrorlist(), read by the de-packages install job
+    static QString rankedMirrorlist();
+
+signals:
+    void finished(bool ranked);
+
+private:
+    struct Probe
+    {
+        QString server;
+        QElapsedTimer timer;
+        qint64 latency = -1;
+        qint64 bytes = 0;
+        qint64 elapsed = 0;
+        bool ok = false;
+
+        qint64 throughput() const { return elapsed > 0 ? bytes * 1000 / elapsed : 0; }
+    };
+
+    void startNextProbes();
+    void onProbeFinished(int index, QNetworkReply* reply);
+    void finish();
+    bool writeRankedList(const QVector<Probe>& ranked, const QStringList& failed);
+
+    QNetworkAccessManager* m_network = nullptr;
+    QVector<Probe> m_probes;
+    int m_nextProbe = 0;
+    int m_activeProbes = 0;
+    qint64 m_bestThroughput = 0;
+    qint64 m_startTime = 0;
+    bool m_running = false;
+    bool m_done = false;
+};
+
+#endif // MIRRORRANKER_H
@@ -0,0 +1,122 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "NetworkManagerClient.h"
+
+#include <QDBusMetaType>
+
+constexpr const char* NM_PATH = "/org/freedesktop/NetworkManager";
+constexpr const char* NM_SETTINGS_PATH = "/org/freedesktop/NetworkManager/Settings";
+constexpr const char* NM_SERVICE = "org.freedesktop.NetworkManager";
+constexpr const char* NM_DEVICE_IFACE = "org.freedesktop.NetworkManager.Device";
+constexpr const char* NM_WIRELESS_IFACE = "org.freedesktop.NetworkManager.Device.Wireless";
+constexpr const char* NM_ACTIVE_IFACE = "org.freedesktop.NetworkManager.Connection.Active";
+constexpr const char* DBUS_PROPERTIES_IFACE = "org.freedesktop.DBus.Properties";
+
+NMObjectWatcher::NMObjectWatcher(const QString& path, const QDBusConnection& bus, QObject* parent)
+    : QObject(parent)
+    , m_path(path)
+    , m_bus(bus)
+{
+}
+
+void
+NMObjectWatcher::watchProperties()
+{
+    m_bus.connect(NM_SERVICE, m_path, DBUS_PROPERTIES_IFACE, QStringLiteral("PropertiesChanged"),
+                  this, SIGNAL(propertiesChanged(QString, QVariantMap, QStringList)));
+}
+
+void
+NMObjectWatcher::watchDeviceState()
+{
+    m_bus.connect(NM_SERVICE, m_path, NM_DEVICE_IFACE, QStringLiteral("StateChanged"),
+                  this, SIGNAL(deviceStateChanged(uint, uint, uint)));
+}
+
+void
+NMObjectWatcher::watchAccessPoints()
+{
+    m_bus.connect(NM_SERVICE, m_path, NM_WIRELESS_IFACE, QStringLiteral("AccessPointAdded"),
+                  this, SIGNAL(accessPointAdded(QDBusObjectPath)));
+    m_bus.connect(NM_SERVICE, m_path, NM_WIRELESS_IFACE, QStringLiteral("AccessPointRemoved"),
+                  this, SIGNAL(accessPointRemoved(QDBusObjectPath)));
+}
+
+void
+NMObjectWatcher::watchActivationState()
+{
+    m_bus.connect(NM_SERVICE, m_path, NM_ACTIVE_IFACE, QStringLiteral("StateChanged"),
+                  this, SIGNAL(activationStateChanged(uint, uint)));
+}
+
+NetworkManagerClient::NetworkManagerClient(const QDBusConnection& bus, QObject* parent)
+    : QObject(parent)
+    , m_bus(bus)
+{
+    qDBusRegisterMetaType<QList<QDBusObjectPath>>();
+    qDBusRegisterMetaType<QList<QByteArray>>();
+    qDBusRegisterMetaType<NMVariantMapMap>();
+}
+
+NetworkManagerClient::~NetworkManagerClient()
+{
+    clear();
+}
+
+template<typename Proxy>
+Proxy*
+NetworkManagerClient::proxy(const QString& path)
+{
+    QDBusAbstractInterface*& cached = m_proxies[path][QLatin1String(Proxy::staticInterfaceName())];
+    if (!cached)
+        cached = new Proxy(path, m_bus, this);
+    return static_cast<Proxy*>(cached);
+}
+
+NMManagerProxy*
+NetworkManagerClient::manager()
+{
+    return proxy<NMManagerProxy>(QString::fromLatin1(NM_PATH));
+}
+
+NMWirelessProxy*
+NetworkManagerClient::wireless(const QDBusObjectPath& device)
+{
+    return proxy<NMWirelessProxy>(device.path());
+}
+
+NMSettingsProxy*
+NetworkManagerClient::settings()
+{
+    return proxy<NMSettingsProxy>(QString::fromLatin1(NM_SETTINGS_PATH));
+}
+
+NMConnectionProxy*
+NetworkManagerClient::connection(const QDBusObjectPath& path)
+{
+    return proxy<NMConnectionProxy>(path.path());
+}
+
+NMPropertiesProxy*
+NetworkManagerClient::properties(const QString& path)
+{
+    return proxy<NMPropertiesProxy>(path);
+}
+
+void
+NetworkManagerClient::forget(const QString& path)
+{
+    // Calls already made keep running; the reply does not need the proxy
+    const auto proxies = m_proxies.take(path);
+    qDeleteAll(proxies);
+}
+
+void
+NetworkManagerClient::clear()
+{
+    for (const auto& proxies : std::as_const(m_proxies))
+        qDeleteAll(proxies);
+    m_proxies.clear();
+}
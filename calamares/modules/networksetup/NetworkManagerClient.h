@@ -0,0 +1,218 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Typed proxies for the NetworkManager calls the network page makes.
+ * Unlike QDBusInterface they do not introspect the remote object, so
+ * every call is a single message.
+ */
+
+#ifndef NETWORKMANAGERCLIENT_H
+#define NETWORKMANAGERCLIENT_H
+
+#include <QDBusAbstractInterface>
+#include <QDBusConnection>
+#include <QDBusObjectPath>
+#include <QDBusPendingReply>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+
+// NM connection settings: a{sa{sv}}
+using NMVariantMapMap = QMap<QString, QVariantMap>;
+Q_DECLARE_METATYPE(NMVariantMapMap)
+
+// org.freedesktop.NetworkManager on /org/freedesktop/NetworkManager
+class NMManagerProxy : public QDBusAbstractInterface
+{
+public:
+    static const char* staticInterfaceName() { return "org.freedesktop.NetworkManager"; }
+
+    NMManagerProxy(const QString& path, const QDBusConnection& bus, QObject* parent)
+        : QDBusAbstractInterface(QStringLiteral("org.freedesktop.NetworkManager"), path,
+                                 staticInterfaceName(), bus, parent)
+    {
+    }
+
+    QDBusPendingReply<QList<QDBusObjectPath>> GetDevices()
+    {
+        return asyncCall(QStringLiteral("GetDevices"));
+    }
+
+    // Returns the new settings path and the ActiveConnection
+    QDBusPendingReply<QDBusObjectPath, QDBusObjectPath>
+    AddAndActivateConnection(const NMVariantMapMap& connection, const QDBusObjectPath& device,
+                             const QDBusObjectPath& specificObject)
+    {
+        return asyncCall(QStringLiteral("AddAndActivateConnection"), QVariant::fromValue(connection),
+                         QVariant::fromValue(device), QVariant::fromValue(specificObject));
+    }
+
+    // Activates a saved connection; returns the ActiveConnection
+    QDBusPendingReply<QDBusObjectPath>
+    ActivateConnection(const QDBusObjectPath& connection, const QDBusObjectPath& device,
+                       const QDBusObjectPath& specificObject)
+    {
+        return asyncCall(QStringLiteral("ActivateConnection"), QVariant::fromValue(connection),
+                         QVariant::fromValue(device), QVariant::fromValue(specificObject));
+    }
+
+    QDBusPendingReply<> DeactivateConnection(const QDBusObjectPath& activeConnection)
+    {
+        return asyncCall(QStringLiteral("DeactivateConnection"), QVariant::fromValue(activeConnection));
+    }
+};
+
+// org.freedesktop.NetworkManager.Device.Wireless
+class NMWirelessProxy : public QDBusAbstractInterface
+{
+public:
+    static const char* staticInterfaceName() { return "org.freedesktop.NetworkManager.Device.Wireless"; }
+
+    NMWirelessProxy(const QString& path, const QDBusConnection& bus, QObject* parent)
+        : QDBusAbstractInterface(QStringLiteral("org.freedesktop.NetworkManager"), path,
+                                 staticInterfaceName(), bus, parent)
+    {
+    }
+
+    QDBusPendingReply<QList<QDBusObjectPath>> GetAccessPoints()
+    {
+        return asyncCall(QStringLiteral("GetAccessPoints"));
+    }
+
+    QDBusPendingReply<> RequestScan(const QVariantMap& options)
+    {
+        return asyncCall(QStringLiteral("RequestScan"), options);
+    }
+};
+
+// org.freedesktop.NetworkManager.Settings on /org/freedesktop/NetworkManager/Settings
+class NMSettingsProxy : public QDBusAbstractInterface
+{
+public:
+    static const char* staticInterfaceName() { return "org.freedesktop.NetworkManager.Settings"; }
+
+    NMSettingsProxy(const QString& path, const QDBusConnection& bus, QObject* parent)
+        : QDBusAbstractInterface(QStringLiteral("org.freedesktop.NetworkManager"), path,
+                                 staticInterfaceName(), bus, parent)
+    {
+    }
+
+    QDBusPendingReply<QList<QDBusObjectPath>> ListConnections()
+    {
+        return asyncCall(QStringLiteral("ListConnections"));
+    }
+};
+
+// org.freedesktop.NetworkManager.Settings.Connection, a saved profile
+class NMConnectionProxy : public QDBusAbstractInterface
+{
+public:
+    static const char* staticInterfaceName() { return "org.freedesktop.NetworkManager.Settings.Connection"; }
+
+    NMConnectionProxy(const QString& path, const QDBusConnection& bus, QObject* parent)
+        : QDBusAbstractInterface(QStringLiteral("org.freedesktop.NetworkManager"), path,
+                                 staticInterfaceName(), bus, parent)
+    {
+    }
+
+    // Everything but the secrets
+    QDBusPendingReply<NMVariantMapMap> GetSettings()
+    {
+        return asyncCall(QStringLiteral("GetSettings"));
+    }
+
+    QDBusPendingReply<NMVariantMapMap> GetSecrets(const QString& settingName)
+    {
+        return asyncCall(QStringLiteral("GetSecrets"), settingName);
+    }
+
+    // Replaces all settings, secrets included
+    QDBusPendingReply<> Update(const NMVariantMapMap& settings)
+    {
+        return asyncCall(QStringLiteral("Update"), QVariant::fromValue(settings));
+    }
+};
+
+// org.freedesktop.DBus.Properties of any NetworkManager object
+class NMPropertiesProxy : public QDBusAbstractInterface
+{
+public:
+    static const char* staticInterfaceName() { return "org.freedesktop.DBus.Properties"; }
+
+    NMPropertiesProxy(const QString& path, const QDBusConnection& bus, QObject* parent)
+        : QDBusAbstractInterface(QStringLiteral("org.freedesktop.NetworkManager"), path,
+                                 staticInterfaceName(), bus, parent)
+    {
+    }
+
+    QDBusPendingReply<QVariant> Get(const QString& interface, const QString& name)
+    {
+        return asyncCall(QStringLiteral("Get"), interface, name);
+    }
+
+    QDBusPendingReply<QVariantMap> GetAll(const QString& interface)
+    {
+        return asyncCall(QStringLiteral("GetAll"), interface);
+    }
+};
+
+// The signals of one NetworkManager object, passed on as Qt signals.
+// QDBusConnection only connects to slots, so this takes the place of a
+// lambda bound to the path: whoever connects to it knows which object it
+// watches. Deleting it drops the subscriptions.
+class NMObjectWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    NMObjectWatcher(const QString& path, const QDBusConnection& bus, QObject* parent);
+
+    // Each subscribes to one group of signals
+    void watchProperties();
+    void watchDeviceState();
+    void watchAccessPoints();
+    void watchActivationState();
+
+signals:
+    void propertiesChanged(const QString& interface, const QVariantMap& changed, const QStringList& invalidated);
+    void deviceStateChanged(uint newState, uint oldState, uint reason);
+    void accessPointAdded(const QDBusObjectPath& path);
+    void accessPointRemoved(const QDBusObjectPath& path);
+    void activationStateChanged(uint state, uint reason);
+
+private:
+    QString m_path;
+    QDBusConnection m_bus;
+};
+
+// Hands out one proxy per object path and interface. Entries for objects
+// NetworkManager removed have to be dropped with forget(), and all of
+// them with clear() when NetworkManager restarts.
+class NetworkManagerClient : public QObject
+{
+public:
+    explicit NetworkManagerClient(const QDBusConnection& bus, QObject* parent = nullptr);
+    ~NetworkManagerClient() override;
+
+    NMManagerProxy* manager();
+    NMWirelessProxy* wireless(const QDBusObjectPath& device);
+    NMSettingsProxy* settings();
+    NMConnectionProxy* connection(const QDBusObjectPath& path);
+    NMPropertiesProxy* properties(const QString& path);
+
+    void forget(const QString& path);
+    void clear();
+
+private:
+    template<typename Proxy>
+    Proxy* proxy(const QString& path);
+
+    QDBusConnection m_bus;
+    // Object path -> interface -> proxy
+    QHash<QString, QHash<QString, QDBusAbstractInterface*>> m_proxies;
+};
+
+#endif // NETWORKMANAGERCLIENT_H
@@ -3,10 +3,15 @@
  */
 
 #include "NetworkSetupPage.h"
+#include "NetworkManagerClient.h"
+
+#include "LocalRepository.h"
+#include "SetupTrace.h"
 
 #include "utils/Logger.h"
 
 #include <algorithm>
+#include <memory>
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -15,40 +20,99 @@
 #include <QListWidget>
 #include <QLineEdit>
 #include <QCheckBox>
-#include <QMessageBox>
 #include <QSet>
 #include <QTimer>
-#include <QDBusInterface>
-#include <QDBusReply>
-#include <QDBusArgument>
-#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
 
 // NM device types
+constexpr uint NM_DEVICE_TYPE_ETHERNET = 1;
 constexpr uint NM_DEVICE_TYPE_WIFI = 2;
 
 // NM device state
+constexpr uint NM_DEVICE_STATE_PREPARE = 40;
+constexpr uint NM_DEVICE_STATE_CONFIG = 50;
+constexpr uint NM_DEVICE_STATE_NEED_AUTH = 60;
+constexpr uint NM_DEVICE_STATE_IP_CONFIG = 70;
+constexpr uint NM_DEVICE_STATE_SECONDARIES = 90;
 constexpr uint NM_DEVICE_STATE_ACTIVATED = 100;
+constexpr uint NM_DEVICE_STATE_FAILED = 120;
+
+// NM device state reason
+constexpr uint NM_DEVICE_STATE_REASON_NO_SECRETS = 7;
+
+// NM active connection state
+constexpr uint NM_ACTIVE_CONNECTION_STATE_ACTIVATED = 2;
+constexpr uint NM_ACTIVE_CONNECTION_STATE_DEACTIVATED = 4;
+
+// NM global state
+constexpr uint NM_STATE_CONNECTED_LOCAL = 50;
+
+// NM connectivity state
+constexpr uint NM_CONNECTIVITY_FULL = 4;
 
 // NM 802.11 AP flags
 constexpr uint NM_802_11_AP_FLAGS_PRIVACY = 0x1;
 
+// Access point replies arriving within this window share one list rebuild
+constexpr int LIST_UPDATE_DELAY_MS = 50;
+
+// A scan normally completes in a few seconds
+constexpr int SCAN_TIMEOUT_MS = 15000;
 
+// Association, authentication and DHCP together; networksetup.conf can
+// change it
+constexpr int CONNECT_TIMEOUT_S = 60;
+
+// The settings NetworkManager keeps a WiFi password in
+constexpr const char* WIRELESS_SECURITY_SETTING = "802-11-wireless-security";
 
 NetworkSetupPage::NetworkSetupPage(QWidget* parent)
     : QWidget(parent)
     , m_bus(QDBusConnection::systemBus())
+    , m_nm(new NetworkManagerClient(m_bus, this))
 {
-    qDBusRegisterMetaType<QList<QDBusObjectPath>>();
-
+    const qint64 constructStart = SetupTrace::now();
     setupUi();
-    findWirelessDevice();
-    checkConnection();  // Check initial connection state (wired or existing WiFi)
-    QTimer::singleShot(500, this, &NetworkSetupPage::scan);
+    findDevices();
+    watchNetworkManager();
+
+    m_listUpdateTimer = new QTimer(this);
+    m_listUpdateTimer->setSingleShot(true);
+    m_listUpdateTimer->setInterval(LIST_UPDATE_DELAY_MS);
+    connect(m_listUpdateTimer, &QTimer::timeout, this, &NetworkSetupPage::updateList);
+
+    // In case LastScan never moves, e.g. the radio went away meanwhile
+    m_scanTimeout = new QTimer(this);
+    m_scanTimeout->setSingleShot(true);
+    m_scanTimeout->setInterval(SCAN_TIMEOUT_MS);
+    connect(m_scanTimeout, &QTimer::timeout, this, &NetworkSetupPage::scanFinished);
+
+    m_connectTimeout = new QTimer(this);
+    m_connectTimeout->setSingleShot(true);
+    m_connectTimeout->setInterval(CONNECT_TIMEOUT_S * 1000);
+    connect(m_connectTimeout, &QTimer::timeout, this, &NetworkSetupPage::onConnectTimeout);
+
+    // NetworkManager restarting drops our subscriptions and the device paths
+    m_serviceWatcher = new QDBusServiceWatcher(NM_SERVICE, m_bus,
+                                               QDBusServiceWatcher::WatchForRegistration, this);
+    connect(m_serviceWatcher, &QDBusServiceWatcher::serviceRegistered, this, [this]() {
+        cDebug() << "NetworkSetup: NetworkManager (re)started";
+        for (auto& device : m_devices)
+            unwatchDevice(device);
+        m_devices.clear();
+        m_accessPoints.clear();
+        ++m_loadGeneration;
+        m_pendingAccessPoints = 0;
+        scheduleListUpdate();
+        m_nm->clear();
+        m_state = NetworkState();
+        findDevices();
+        watchNetworkManager();
+    });
 
-    // Periodically check connection state (detects ethernet plug-in, etc.)
-    m_connectionCheckTimer = new QTimer(this);
-    connect(m_connectionCheckTimer, &QTimer::timeout, this, &NetworkSetupPage::checkConnection);
-    m_connectionCheckTimer->start(2000);  // Check every 2 seconds
+    SetupTrace::complete(QStringLiteral("networksetup-page"), QStringLiteral("module"), constructStart);
 }
 
 void
@@ -104,9 +168,24 @@ NetworkSetupPage::setupUi()
     connect(m_connectBtn, &QPushButton::clicked, this, &NetworkSetupPage::onConnect);
     btnLayout->addWidget(m_connectBtn);
 
+    // Only shown while a connection attempt runs
+    m_cancelConnectBtn = new QPushButton(tr("Cancel"));
+    connect(m_cancelConnectBtn, &QPushButton::clicked, this, &NetworkSetupPage::onCancelConnect);
+    m_cancelConnectBtn->hide();
+    btnLayout->addWidget(m_cancelConnectBtn);
+
     btnLayout->addStretch();
     layout->addLayout(btnLayout);
 
+    // Only offered when the media carries a local repository; which
+    // desktops it covers depends on what went into `make local-repo`
+    if (LocalRepository::exists())
+    {
+        m_offlineCheck = new QCheckBox(tr("Continue without a network and install from the packages on this disk"));
+        connect(m_offlineCheck, &QCheckBox::toggled, this, &NetworkSetupPage::offlineInstallChanged);
+        layout->addWidget(m_offlineCheck);
+    }
+
     // Inline password area (hidden by default)
     m_passwordWidget = new QWidget();
     auto* pwLayout = new QVBoxLayout(m_passwordWidget);
@@ -146,7 +225,20 @@ NetworkSetupPage::setupUi()
 }
 
 void
-NetworkSetupPage::findWirelessDevice()
+NetworkSetupPage::setOfflineInstall(bool offline)
+{
+    if (m_offlineCheck)
+        m_offlineCheck->setChecked(offline);
+}
+
+void
+NetworkSetupPage::setConnectTimeout(int seconds)
+{
+    m_connectTimeout->setInterval(std::max(seconds, 0) * 1000);
+}
+
+void
+NetworkSetupPage::findDevices()
 {
     if (!m_bus.isConnected())
     {
@@ -154,147 +246,382 @@ NetworkSetupPage::findWirelessDevice()
         return;
     }
 
-    QDBusInterface nm(NM_SERVICE, NM_PATH, NM_IFACE, m_bus);
-    if (!nm.isValid())
+    const int generation = ++m_deviceGeneration;
+    auto* watcher = new QDBusPendingCallWatcher(m_nm->manager()->GetDevices(), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, generation](QDBusPendingCallWatcher* call) {
+        call->deleteLater();
+        QDBusPendingReply<QList<QDBusObjectPath>> reply = *call;
+        if (generation != m_deviceGeneration)
+            return;
+        if (reply.isError())
+        {
+            cWarning() << "NetworkSetup: GetDevices failed:" << reply.error().message();
+            return;
+        }
+
+        // Every device's type at once; the answers are collected in
+        // NetworkManager's device order
+        const QList<QDBusObjectPath> devices = reply.value();
+        auto types = std::make_shared<QList<uint>>(devices.size(), 0);
+        auto remaining = std::make_shared<int>(devices.size());
+        if (devices.isEmpty())
+            useDevices(devices, *types);
+        for (int i = 0; i < devices.size(); ++i)
+        {
+            auto* typeWatcher = new QDBusPendingCallWatcher(
+                m_nm->properties(devices[i].path())->Get(NM_DEVICE_IFACE, QStringLiteral("DeviceType")), this);
+            connect(typeWatcher, &QDBusPendingCallWatcher::finished, this,
+                    [this, generation, devices, types, remaining, i](QDBusPendingCallWatcher* typeCall) {
+                typeCall->deleteLater();
+                QDBusPendingReply<QVariant> typeReply = *typeCall;
+                if (generation != m_deviceGeneration)
+                    return;
+                if (!typeReply.isError())
+                    (*types)[i] = typeReply.value().toUInt();
+                if (--*remaining == 0)
+                    useDevices(devices, *types);
+            });
+        }
+    });
+}
+
+void
+NetworkSetupPage::useDevices(const QList<QDBusObjectPath>& devices, const QList<uint>& types)
+{
+    for (int i = 0; i < devices.size(); ++i)
+        addDevice(devices.at(i), types.at(i));
+
+    if (!hasWirelessDevice())
     {
-        cWarning() << "NetworkSetup: NetworkManager service not available";
-        return;
+        cWarning() << "NetworkSetup: no WiFi device found";
+        if (!m_isConnected)
+            m_statusLabel->setText(tr("No WiFi adapter found"));
     }
+}
 
-    // Get all devices
-    QDBusReply<QList<QDBusObjectPath>> reply = nm.call(QStringLiteral("GetDevices"));
-    if (!reply.isValid())
-    {
-        cWarning() << "NetworkSetup: GetDevices failed:" << reply.error().message();
+void
+NetworkSetupPage::addDevice(const QDBusObjectPath& path, uint type)
+{
+    if ((type != NM_DEVICE_TYPE_WIFI && type != NM_DEVICE_TYPE_ETHERNET) || findDevice(path.path()))
         return;
+
+    Device device;
+    device.path = path;
+    device.type = type;
+    m_devices.append(device);
+    cDebug() << "NetworkSetup: found" << (type == NM_DEVICE_TYPE_WIFI ? "wireless" : "wired")
+             << "device at" << path.path();
+    watchDevice(m_devices.last());
+
+    // Another radio, e.g. a USB dongle, joins the running scan or starts one
+    if (type == NM_DEVICE_TYPE_WIFI)
+    {
+        if (m_scanning)
+            requestDeviceScan(path);
+        else
+            scan();
     }
+}
 
-    for (const auto& devicePath : reply.value())
+NetworkSetupPage::Device*
+NetworkSetupPage::findDevice(const QString& path)
+{
+    for (auto& device : m_devices)
     {
-        QDBusInterface device(NM_SERVICE, devicePath.path(),
-                              QStringLiteral("org.freedesktop.DBus.Properties"), m_bus);
+        if (device.path.path() == path)
+            return &device;
+    }
+    return nullptr;
+}
 
-        QDBusReply<QVariant> typeReply = device.call(
-            QStringLiteral("Get"), NM_DEVICE_IFACE, QStringLiteral("DeviceType"));
+bool
+NetworkSetupPage::hasWirelessDevice() const
+{
+    return std::any_of(m_devices.cbegin(), m_devices.cend(),
+                       [](const Device& device) { return device.type == NM_DEVICE_TYPE_WIFI; });
+}
 
-        if (typeReply.isValid() && typeReply.value().toUInt() == NM_DEVICE_TYPE_WIFI)
-        {
-            m_wirelessDevice = devicePath;
-            cDebug() << "NetworkSetup: found wireless device at" << devicePath.path();
-            return;
-        }
+void
+NetworkSetupPage::onDeviceAdded(const QDBusObjectPath& path)
+{
+    const int generation = m_deviceGeneration;
+    auto* watcher = new QDBusPendingCallWatcher(
+        m_nm->properties(path.path())->Get(NM_DEVICE_IFACE, QStringLiteral("DeviceType")), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, path, generation](QDBusPendingCallWatcher* call) {
+        call->deleteLater();
+        QDBusPendingReply<QVariant> reply = *call;
+        if (generation == m_deviceGeneration && !reply.isError())
+            addDevice(path, reply.value().toUInt());
+    });
+}
+
+void
+NetworkSetupPage::onDeviceRemoved(const QDBusObjectPath& path)
+{
+    const auto it = std::find_if(m_devices.begin(), m_devices.end(),
+                                 [&path](const Device& device) { return device.path == path; });
+    if (it == m_devices.end())
+    {
+        m_nm->forget(path.path());
+        return;
     }
 
-    cWarning() << "NetworkSetup: no WiFi device found";
+    cDebug() << "NetworkSetup: device" << path.path() << "went away";
+    unwatchDevice(*it);
+    const bool scanning = it->scanning;
+    m_devices.erase(it);
+
+    // Its networks go with it; another radio reports its own entries
+    m_accessPoints.erase(std::remove_if(m_accessPoints.begin(), m_accessPoints.end(),
+                                        [this, &path](const AccessPointInfo& ap) {
+                                            if (ap.device != path)
+                                                return false;
+                                            m_nm->forget(ap.path.path());
+                                            return true;
+                                        }),
+                         m_accessPoints.end());
+    scheduleListUpdate();
+    if (scanning)
+        deviceScanFinished(path);
+    updateConnectionState();
 }
 
 void
 NetworkSetupPage::scan()
 {
-    if (m_wirelessDevice.path().isEmpty())
+    if (!hasWirelessDevice())
     {
         m_statusLabel->setText(tr("No WiFi adapter found"));
         return;
     }
 
+    m_scanStart = SetupTrace::now();
+    requestScan(QString());
+}
+
+void
+NetworkSetupPage::requestScan(const QString& ssid)
+{
     m_scanBtn->setEnabled(false);
     m_scanBtn->setText(tr("Scanning..."));
+    m_scanning = true;
+    m_scanSsid = ssid;
+    m_scanTimeout->start();
 
-    QDBusInterface wireless(NM_SERVICE, m_wirelessDevice.path(), NM_WIRELESS_IFACE, m_bus);
-    if (wireless.isValid())
+    // Every radio at once; the list merges what they find
+    for (const auto& device : std::as_const(m_devices))
     {
-        // RequestScan takes a dict of options (empty for default scan)
-        QVariantMap options;
-        wireless.call(QDBus::NoBlock, QStringLiteral("RequestScan"), options);
-        QTimer::singleShot(3000, this, &NetworkSetupPage::loadAccessPoints);
-    }
-    else
-    {
-        m_scanBtn->setEnabled(true);
-        m_scanBtn->setText(tr("Scan"));
-        cWarning() << "NetworkSetup: wireless interface invalid";
+        if (device.type == NM_DEVICE_TYPE_WIFI)
+            requestDeviceScan(device.path);
     }
+    if (!hasWirelessDevice())
+        scanFinished();
 }
 
 void
-NetworkSetupPage::loadAccessPoints()
+NetworkSetupPage::requestDeviceScan(const QDBusObjectPath& path)
 {
-    m_scanBtn->setEnabled(true);
-    m_scanBtn->setText(tr("Scan"));
-
-    if (m_wirelessDevice.path().isEmpty())
+    Device* device = findDevice(path.path());
+    if (!device)
         return;
+    device->scanning = true;
+
+    // RequestScan takes a dict of options; "ssids" limits it to those
+    // networks, which is quicker and finds hidden ones
+    QVariantMap options;
+    if (!m_scanSsid.isEmpty())
+        options.insert(QStringLiteral("ssids"), QVariant::fromValue(QList<QByteArray>{ m_scanSsid.toUtf8() }));
+
+    auto* watcher = new QDBusPendingCallWatcher(m_nm->wireless(path)->RequestScan(options), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, path](QDBusPendingCallWatcher* call) {
+        call->deleteLater();
+        QDBusPendingReply<> reply = *call;
+        if (!reply.isError())
+            return;
+        // Typically a scan that is already running or was just done;
+        // what NetworkManager has is as good as it gets right now
+        cDebug() << "NetworkSetup: RequestScan on" << path.path() << "-" << reply.error().message();
+        deviceScanFinished(path);
+    });
+}
 
-    QDBusInterface wireless(NM_SERVICE, m_wirelessDevice.path(), NM_WIRELESS_IFACE, m_bus);
-    if (!wireless.isValid())
-        return;
+void
+NetworkSetupPage::deviceScanFinished(const QDBusObjectPath& path)
+{
+    Device* device = findDevice(path.path());
+    if (device)
+        device->scanning = false;
 
-    m_accessPoints.clear();
+    // The scan is over once the last radio has reported
+    if (std::none_of(m_devices.cbegin(), m_devices.cend(), [](const Device& other) { return other.scanning; }))
+        scanFinished();
+}
 
-    // Get access points
-    QDBusReply<QList<QDBusObjectPath>> reply = wireless.call(QStringLiteral("GetAccessPoints"));
-    if (!reply.isValid())
-    {
-        cWarning() << "NetworkSetup: GetAccessPoints failed:" << reply.error().message();
+void
+NetworkSetupPage::scanFinished()
+{
+    if (!m_scanning)
         return;
-    }
+    m_scanning = false;
+    for (auto& device : m_devices)
+        device.scanning = false;
+    m_scanTimeout->stop();
+    m_scanBtn->setEnabled(true);
+    m_scanBtn->setText(tr("Scan"));
+    finishScan();
 
-    for (const auto& apPath : reply.value())
+    if (m_pendingConnect.active)
     {
-        QDBusInterface ap(NM_SERVICE, apPath.path(),
-                          QStringLiteral("org.freedesktop.DBus.Properties"), m_bus);
-
-        QDBusReply<QVariant> ssidReply = ap.call(
-            QStringLiteral("Get"), NM_AP_IFACE, QStringLiteral("Ssid"));
-        QDBusReply<QVariant> strengthReply = ap.call(
-            QStringLiteral("Get"), NM_AP_IFACE, QStringLiteral("Strength"));
-        QDBusReply<QVariant> flagsReply = ap.call(
-            QStringLiteral("Get"), NM_AP_IFACE, QStringLiteral("Flags"));
-        QDBusReply<QVariant> wpaFlagsReply = ap.call(
-            QStringLiteral("Get"), NM_AP_IFACE, QStringLiteral("WpaFlags"));
-        QDBusReply<QVariant> rsnFlagsReply = ap.call(
-            QStringLiteral("Get"), NM_AP_IFACE, QStringLiteral("RsnFlags"));
-
-        if (!ssidReply.isValid())
-            continue;
+        m_pendingConnect.active = false;
+        activateConnection();
+    }
+}
 
-        QByteArray ssidBytes = ssidReply.value().toByteArray();
-        QString ssid = QString::fromUtf8(ssidBytes);
+void
+NetworkSetupPage::loadAccessPoints(const QDBusObjectPath& device)
+{
+    // The list itself counts as pending, so the scan is not over before
+    // this device's access points are known
+    const int generation = m_loadGeneration;
+    ++m_pendingAccessPoints;
+    auto* watcher = new QDBusPendingCallWatcher(m_nm->wireless(device)->GetAccessPoints(), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this,
+            [this, device, generation](QDBusPendingCallWatcher* call) {
+        call->deleteLater();
+        QDBusPendingReply<QList<QDBusObjectPath>> reply = *call;
+        if (generation != m_loadGeneration)
+            return;
+        if (reply.isError())
+        {
+            cWarning() << "NetworkSetup: GetAccessPoints failed:" << reply.error().message();
+        }
+        else if (findDevice(device.path()))
+        {
+            // Drop what this device no longer sees; the rest is refreshed
+            // as replies arrive
+            const QList<QDBusObjectPath> paths = reply.value();
+            m_accessPoints.erase(std::remove_if(m_accessPoints.begin(), m_accessPoints.end(),
+                                                [&device, &paths](const AccessPointInfo& ap) {
+                                                    return ap.device == device && !paths.contains(ap.path);
+                                                }),
+                                 m_accessPoints.end());
+            scheduleListUpdate();
+
+            // One GetAll per access point, all in flight at once
+            m_pendingAccessPoints += paths.size();
+            for (const auto& apPath : paths)
+            {
+                fetchProperties(apPath.path(), NM_AP_IFACE,
+                                [this, device, apPath, generation](const QVariantMap& properties) {
+                    if (generation != m_loadGeneration)
+                        return;
+                    if (findDevice(device.path()))
+                        updateAccessPoint(device, apPath, properties);
+                    accessPointLoaded();
+                }, [this, generation]() {
+                    if (generation == m_loadGeneration)
+                        accessPointLoaded();
+                });
+            }
+        }
+        accessPointLoaded();
+    });
+}
 
-        if (ssid.isEmpty())
-            continue;
+void
+NetworkSetupPage::accessPointLoaded()
+{
+    if (--m_pendingAccessPoints == 0)
+        finishScan();
+}
 
-        AccessPointInfo info;
-        info.path = apPath;
-        info.ssid = ssid;
-        info.strength = strengthReply.isValid() ? strengthReply.value().toUInt() : 0;
-        info.flags = flagsReply.isValid() ? flagsReply.value().toUInt() : 0;
-        info.wpaFlags = wpaFlagsReply.isValid() ? wpaFlagsReply.value().toUInt() : 0;
-        info.rsnFlags = rsnFlagsReply.isValid() ? rsnFlagsReply.value().toUInt() : 0;
+void
+NetworkSetupPage::updateAccessPoint(const QDBusObjectPath& device, const QDBusObjectPath& path,
+                                    const QVariantMap& properties)
+{
+    auto it = std::find_if(m_accessPoints.begin(), m_accessPoints.end(),
+                           [&path](const AccessPointInfo& ap) { return ap.path == path; });
 
-        // Network is secured if privacy flag is set or WPA/RSN flags are non-zero
-        info.secured = (info.flags & NM_802_11_AP_FLAGS_PRIVACY) ||
-                       info.wpaFlags != 0 || info.rsnFlags != 0;
+    const QString ssid = QString::fromUtf8(properties.value(QStringLiteral("Ssid")).toByteArray());
+    if (ssid.isEmpty())
+    {
+        // Hidden networks cannot be picked from the list
+        if (it != m_accessPoints.end())
+            m_accessPoints.erase(it);
+        return;
+    }
 
+    AccessPointInfo info;
+    info.path = path;
+    info.device = device;
+    info.ssid = ssid;
+    info.strength = properties.value(QStringLiteral("Strength")).toUInt();
+    info.flags = properties.value(QStringLiteral("Flags")).toUInt();
+    info.wpaFlags = properties.value(QStringLiteral("WpaFlags")).toUInt();
+    info.rsnFlags = properties.value(QStringLiteral("RsnFlags")).toUInt();
+
+    // Network is secured if privacy flag is set or WPA/RSN flags are non-zero
+    info.secured = (info.flags & NM_802_11_AP_FLAGS_PRIVACY) ||
+                   info.wpaFlags != 0 || info.rsnFlags != 0;
+
+    if (it != m_accessPoints.end())
+        *it = info;
+    else
         m_accessPoints.append(info);
+
+    Device* owner = findDevice(device.path());
+    if (owner && path == owner->activeAccessPoint && owner->activeSsid.isEmpty())
+    {
+        owner->activeSsid = ssid;
+        updateConnectionState();
     }
+    scheduleListUpdate();
+}
 
-    // Sort by signal strength (descending)
-    std::sort(m_accessPoints.begin(), m_accessPoints.end(),
-              [](const AccessPointInfo& a, const AccessPointInfo& b) {
-                  return a.strength > b.strength;
-              });
+void
+NetworkSetupPage::finishScan()
+{
+    // Over once every radio has reported and what they found is loaded
+    if (m_scanning || m_pendingAccessPoints > 0 || m_scanStart == 0)
+        return;
+    const int radios = int(std::count_if(m_devices.cbegin(), m_devices.cend(),
+                                         [](const Device& device) { return device.type == NM_DEVICE_TYPE_WIFI; }));
+    SetupTrace::complete(QStringLiteral("wifi-scan"), QStringLiteral("network"), m_scanStart,
+                         { { QStringLiteral("accessPoints"), int(m_accessPoints.size()) },
+                           { QStringLiteral("devices"), radios } });
+    m_scanStart = 0;
+}
 
-    updateList();
-    checkConnection();
+void
+NetworkSetupPage::scheduleListUpdate()
+{
+    // Replies come in bursts; one rebuild per burst is enough
+    if (!m_listUpdateTimer->isActive())
+        m_listUpdateTimer->start();
 }
 
 void
 NetworkSetupPage::updateList()
 {
+    // Sort by signal strength (descending)
+    std::stable_sort(m_accessPoints.begin(), m_accessPoints.end(),
+                     [](const AccessPointInfo& a, const AccessPointInfo& b) {
+                         return a.strength > b.strength;
+                     });
+
+    // Keep the user's pick across the rebuild
+    const QString selectedSsid = m_networkList->currentItem()
+        ? m_networkList->currentItem()->data(Qt::UserRole + 1).toString()
+        : QString();
+
     m_networkList->clear();
 
-    // Track seen SSIDs to avoid duplicates
+    // With several radios, each network names the one that sees it best
+    const bool severalRadios = std::count_if(m_devices.cbegin(), m_devices.cend(), [](const Device& device) {
+        return device.type == NM_DEVICE_TYPE_WIFI;
+    }) > 1;
+
+    // Sorted by strength, so the first entry per SSID is the best one
     QSet<QString> seenSsids;
 
     for (const auto& ap : m_accessPoints)
@@ -315,6 +642,9 @@ NetworkSetupPage::updateList()
             strengthStr = QStringLiteral("\u2582");
 
         QString text = QStringLiteral("%1  %2  (%3)").arg(strengthStr, ap.ssid, secType);
+        const Device* device = severalRadios ? findDevice(ap.device.path()) : nullptr;
+        if (device && !device->interface.isEmpty())
+            text += QStringLiteral("  [%1]").arg(device->interface);
 
         auto* item = new QListWidgetItem(text);
         item->setData(Qt::UserRole, QVariant::fromValue(ap.path.path()));
@@ -322,87 +652,388 @@ NetworkSetupPage::updateList()
         item->setData(Qt::UserRole + 2, QVariant::fromValue(ap.secured));
 
         m_networkList->addItem(item);
+        if (ap.ssid == selectedSsid)
+            m_networkList->setCurrentItem(item);
     }
 }
 
 void
-NetworkSetupPage::checkConnection()
+NetworkSetupPage::watchNetworkManager()
 {
-    bool wasConnected = m_isConnected;
-    m_isConnected = false;
-    QString connectionName;
+    if (!m_bus.isConnected())
+        return;
+
+    // Subscribing is idempotent for the same receiver and slot
+    m_bus.connect(NM_SERVICE, NM_PATH, DBUS_PROPERTIES_IFACE, QStringLiteral("PropertiesChanged"),
+                  this, SLOT(onManagerPropertiesChanged(QString, QVariantMap, QStringList)));
+    m_bus.connect(NM_SERVICE, NM_PATH, NM_IFACE, QStringLiteral("StateChanged"),
+                  this, SLOT(onManagerStateChanged(uint)));
+    m_bus.connect(NM_SERVICE, NM_PATH, NM_IFACE, QStringLiteral("DeviceAdded"),
+                  this, SLOT(onDeviceAdded(QDBusObjectPath)));
+    m_bus.connect(NM_SERVICE, NM_PATH, NM_IFACE, QStringLiteral("DeviceRemoved"),
+                  this, SLOT(onDeviceRemoved(QDBusObjectPath)));
+    fetchProperties(NM_PATH, NM_IFACE, [this](const QVariantMap& properties) {
+        applyManagerProperties(properties);
+    });
+}
 
-    // First check NetworkManager's global connectivity state
-    // This catches wired connections and any existing network access
-    QDBusInterface nm(NM_SERVICE, NM_PATH,
-                      QStringLiteral("org.freedesktop.DBus.Properties"), m_bus);
-    if (nm.isValid())
+void
+NetworkSetupPage::watchDevice(Device& device)
+{
+    const QDBusObjectPath path = device.path;
+    auto* watcher = new NMObjectWatcher(path.path(), m_bus, this);
+    device.watcher = watcher;
+    connect(watcher, &NMObjectWatcher::propertiesChanged, this,
+            [this, path](const QString& interface, const QVariantMap& changed) {
+        if (interface == QLatin1String(NM_DEVICE_IFACE) || interface == QLatin1String(NM_WIRELESS_IFACE)
+            || interface == QLatin1String(NM_WIRED_IFACE))
+            applyDeviceProperties(path, changed);
+    });
+    connect(watcher, &NMObjectWatcher::deviceStateChanged, this,
+            [this, path](uint newState, uint, uint reason) { onDeviceStateChanged(path, newState, reason); });
+    watcher->watchProperties();
+    watcher->watchDeviceState();
+    const auto apply = [this, path](const QVariantMap& properties) {
+        applyDeviceProperties(path, properties);
+    };
+    fetchProperties(path.path(), NM_DEVICE_IFACE, apply);
+
+    if (device.type == NM_DEVICE_TYPE_ETHERNET)
     {
-        QDBusReply<QVariant> connReply = nm.call(
-            QStringLiteral("Get"), NM_IFACE, QStringLiteral("Connectivity"));
-        // NM_CONNECTIVITY_FULL = 4
-        if (connReply.isValid() && connReply.value().toUInt() == 4)
+        fetchProperties(path.path(), NM_WIRED_IFACE, apply);
+        return;
+    }
+
+    connect(watcher, &NMObjectWatcher::accessPointAdded, this,
+            [this, path](const QDBusObjectPath& accessPoint) { onAccessPointAdded(path, accessPoint); });
+    connect(watcher, &NMObjectWatcher::accessPointRemoved, this, &NetworkSetupPage::onAccessPointRemoved);
+    watcher->watchAccessPoints();
+    // Every access point, filtered on the interface argument; one match
+    // rule instead of one per access point
+    m_bus.connect(NM_SERVICE, QString(), DBUS_PROPERTIES_IFACE, QStringLiteral("PropertiesChanged"),
+                  { QString::fromLatin1(NM_AP_IFACE) }, QString(),
+                  this, SLOT(onAccessPointPropertiesChanged(QString, QVariantMap, QStringList, QDBusMessage)));
+    loadAccessPoints(path);
+    fetchProperties(path.path(), NM_WIRELESS_IFACE, apply);
+}
+
+void
+NetworkSetupPage::unwatchDevice(Device& device)
+{
+    unwatch(device.watcher);
+    m_nm->forget(device.path.path());
+}
+
+void
+NetworkSetupPage::unwatch(NMObjectWatcher*& watcher)
+{
+    if (!watcher)
+        return;
+    // It may be the sender of the signal being handled
+    watcher->disconnect(this);
+    watcher->deleteLater();
+    watcher = nullptr;
+}
+
+void
+NetworkSetupPage::fetchProperties(const QString& path, const QString& interface,
+                                  std::function<void(const QVariantMap&)> apply,
+                                  std::function<void()> failed)
+{
+    auto* watcher = new QDBusPendingCallWatcher(m_nm->properties(path)->GetAll(interface), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this,
+            [apply = std::move(apply), failed = std::move(failed), path, interface](QDBusPendingCallWatcher* call) {
+        call->deleteLater();
+        QDBusPendingReply<QVariantMap> reply = *call;
+        if (reply.isError())
         {
-            m_isConnected = true;
+            cWarning() << "NetworkSetup: GetAll" << interface << "on" << path << "failed:"
+                       << reply.error().message();
+            if (failed)
+                failed();
+            return;
+        }
+        apply(reply.value());
+    });
+}
 
-            // Try to get the primary connection name
-            QDBusReply<QVariant> primaryReply = nm.call(
-                QStringLiteral("Get"), NM_IFACE, QStringLiteral("PrimaryConnection"));
-            if (primaryReply.isValid())
-            {
-                QDBusObjectPath connPath = primaryReply.value().value<QDBusObjectPath>();
-                if (!connPath.path().isEmpty() && connPath.path() != QStringLiteral("/"))
-                {
-                    QDBusInterface conn(NM_SERVICE, connPath.path(),
-                                        QStringLiteral("org.freedesktop.DBus.Properties"), m_bus);
-                    QDBusReply<QVariant> idReply = conn.call(
-                        QStringLiteral("Get"),
-                        QStringLiteral("org.freedesktop.NetworkManager.Connection.Active"),
-                        QStringLiteral("Id"));
-                    if (idReply.isValid())
-                        connectionName = idReply.value().toString();
-                }
-            }
+void
+NetworkSetupPage::onManagerPropertiesChanged(const QString& interface, const QVariantMap& changed,
+                                             const QStringList& invalidated)
+{
+    Q_UNUSED(invalidated)
+    if (interface == QLatin1String(NM_IFACE))
+        applyManagerProperties(changed);
+}
+
+void
+NetworkSetupPage::onManagerStateChanged(uint state)
+{
+    // Connectivity follows in PropertiesChanged; this only shortens the
+    // wait when NetworkManager loses every connection at once
+    if (state < NM_STATE_CONNECTED_LOCAL && m_state.connectivity == NM_CONNECTIVITY_FULL)
+    {
+        m_state.connectivity = 0;
+        updateConnectionState();
+    }
+}
+
+void
+NetworkSetupPage::applyManagerProperties(const QVariantMap& properties)
+{
+    const auto connectivity = properties.constFind(QStringLiteral("Connectivity"));
+    if (connectivity != properties.constEnd())
+        m_state.connectivity = connectivity->toUInt();
+
+    const auto primary = properties.constFind(QStringLiteral("PrimaryConnection"));
+    if (primary != properties.constEnd())
+        watchActiveConnection(primary->value<QDBusObjectPath>());
+
+    updateConnectionState();
+}
+
+void
+NetworkSetupPage::watchActiveConnection(const QDBusObjectPath& path)
+{
+    if (path == m_watchedConnection)
+        return;
+
+    if (!m_watchedConnection.path().isEmpty())
+    {
+        unwatch(m_connectionWatcher);
+        if (m_watchedConnection != m_activation)
+            m_nm->forget(m_watchedConnection.path());
+    }
+
+    m_watchedConnection = path;
+    m_state.primaryConnection = path;
+    m_state.primaryConnectionId.clear();
+    if (path.path().isEmpty() || path.path() == QStringLiteral("/"))
+        return;
+
+    m_connectionWatcher = new NMObjectWatcher(path.path(), m_bus, this);
+    connect(m_connectionWatcher, &NMObjectWatcher::propertiesChanged, this,
+            [this](const QString& interface, const QVariantMap& changed) {
+        onActiveConnectionPropertiesChanged(interface, changed);
+    });
+    m_connectionWatcher->watchProperties();
+    fetchProperties(path.path(), NM_ACTIVE_IFACE, [this, path](const QVariantMap& properties) {
+        if (path != m_watchedConnection)
+            return;
+        m_state.primaryConnectionId = properties.value(QStringLiteral("Id")).toString();
+        updateConnectionState();
+    });
+}
+
+void
+NetworkSetupPage::onActiveConnectionPropertiesChanged(const QString& interface, const QVariantMap& changed)
+{
+    if (interface != QLatin1String(NM_ACTIVE_IFACE) || !changed.contains(QStringLiteral("Id")))
+        return;
+    m_state.primaryConnectionId = changed.value(QStringLiteral("Id")).toString();
+    updateConnectionState();
+}
+
+void
+NetworkSetupPage::onDeviceStateChanged(const QDBusObjectPath& path, uint newState, uint reason)
+{
+    Device* device = findDevice(path.path());
+    if (!device)
+        return;
+    device->state = newState;
+
+    if (m_connectStart > 0 && device->path == m_pendingConnect.device)
+    {
+        // The device walks through these while our connection activates
+        if (newState == NM_DEVICE_STATE_FAILED)
+        {
+            cWarning() << "NetworkSetup: activation failed, reason" << reason;
+            if (reason == NM_DEVICE_STATE_REASON_NO_SECRETS)
+                finishConnect(false, tr("The password for %1 was not accepted").arg(m_pendingConnect.ssid));
+            else
+                finishConnect(false, tr("Connection failed"));
+            return;
         }
+        if (newState >= NM_DEVICE_STATE_PREPARE && newState < NM_DEVICE_STATE_NEED_AUTH)
+            m_statusLabel->setText(tr("Associating with %1...").arg(m_pendingConnect.ssid));
+        else if (newState == NM_DEVICE_STATE_NEED_AUTH)
+            m_statusLabel->setText(tr("Authenticating..."));
+        else if (newState >= NM_DEVICE_STATE_IP_CONFIG && newState <= NM_DEVICE_STATE_SECONDARIES)
+            m_statusLabel->setText(tr("Obtaining an IP address..."));
     }
+    updateConnectionState();
+}
+
+void
+NetworkSetupPage::onAccessPointAdded(const QDBusObjectPath& device, const QDBusObjectPath& path)
+{
+    const int generation = m_loadGeneration;
+    fetchProperties(path.path(), NM_AP_IFACE, [this, device, path, generation](const QVariantMap& properties) {
+        if (generation == m_loadGeneration && findDevice(device.path()))
+            updateAccessPoint(device, path, properties);
+    });
+}
+
+void
+NetworkSetupPage::onAccessPointRemoved(const QDBusObjectPath& path)
+{
+    const auto it = std::find_if(m_accessPoints.begin(), m_accessPoints.end(),
+                                 [&path](const AccessPointInfo& ap) { return ap.path == path; });
+    m_nm->forget(path.path());
+    if (it == m_accessPoints.end())
+        return;
+    m_accessPoints.erase(it);
+    scheduleListUpdate();
+}
+
+void
+NetworkSetupPage::onAccessPointPropertiesChanged(const QString& interface, const QVariantMap& changed,
+                                                 const QStringList& invalidated, const QDBusMessage& message)
+{
+    Q_UNUSED(invalidated)
+    if (interface != QLatin1String(NM_AP_IFACE))
+        return;
+
+    // Only entries already listed; new ones come with AccessPointAdded
+    const QDBusObjectPath path(message.path());
+    const auto it = std::find_if(m_accessPoints.begin(), m_accessPoints.end(),
+                                 [&path](const AccessPointInfo& ap) { return ap.path == path; });
+    if (it == m_accessPoints.end())
+        return;
 
-    // Also check WiFi device state (for display purposes)
-    if (!m_isConnected && !m_wirelessDevice.path().isEmpty())
+    const auto strength = changed.constFind(QStringLiteral("Strength"));
+    if (strength == changed.constEnd() || strength->toUInt() == it->strength)
+        return;
+    it->strength = strength->toUInt();
+    scheduleListUpdate();
+}
+
+void
+NetworkSetupPage::applyDeviceProperties(const QDBusObjectPath& path, const QVariantMap& properties)
+{
+    Device* device = findDevice(path.path());
+    if (!device)
+        return;
+
+    const auto state = properties.constFind(QStringLiteral("State"));
+    if (state != properties.constEnd())
+        device->state = state->toUInt();
+
+    const auto interface = properties.constFind(QStringLiteral("Interface"));
+    if (interface != properties.constEnd())
     {
-        QDBusInterface device(NM_SERVICE, m_wirelessDevice.path(),
-                              QStringLiteral("org.freedesktop.DBus.Properties"), m_bus);
+        device->interface = interface->toString();
+        scheduleListUpdate();
+    }
 
-        QDBusReply<QVariant> stateReply = device.call(
-            QStringLiteral("Get"), NM_DEVICE_IFACE, QStringLiteral("State"));
+    // Link state of a cable; NetworkManager activates it on its own
+    const auto carrier = properties.constFind(QStringLiteral("Carrier"));
+    if (carrier != properties.constEnd())
+        device->carrier = carrier->toBool();
+    const auto speed = properties.constFind(QStringLiteral("Speed"));
+    if (speed != properties.constEnd())
+        device->speed = speed->toUInt();
+
+    // The device bumps LastScan when results are in, whoever asked
+    bool scanned = false;
+    const auto lastScan = properties.constFind(QStringLiteral("LastScan"));
+    if (lastScan != properties.constEnd() && lastScan->toLongLong() != device->lastScan)
+    {
+        scanned = device->lastScan != LAST_SCAN_UNKNOWN;
+        device->lastScan = lastScan->toLongLong();
+    }
 
-        if (stateReply.isValid() && stateReply.value().toUInt() == NM_DEVICE_STATE_ACTIVATED)
+    const auto ap = properties.constFind(QStringLiteral("ActiveAccessPoint"));
+    if (ap != properties.constEnd())
+    {
+        const QDBusObjectPath apPath = ap->value<QDBusObjectPath>();
+        if (apPath != device->activeAccessPoint)
         {
-            m_isConnected = true;
+            device->activeAccessPoint = apPath;
+            device->activeSsid.clear();
+            fetchActiveSsid(path);
+        }
+    }
 
-            // Get active access point name
-            QDBusInterface wireless(NM_SERVICE, m_wirelessDevice.path(),
-                                    QStringLiteral("org.freedesktop.DBus.Properties"), m_bus);
-            QDBusReply<QVariant> apReply = wireless.call(
-                QStringLiteral("Get"), NM_WIRELESS_IFACE, QStringLiteral("ActiveAccessPoint"));
+    updateConnectionState();
+    if (scanned)
+        deviceScanFinished(path);
+}
 
-            if (apReply.isValid())
-            {
-                QDBusObjectPath apPath = apReply.value().value<QDBusObjectPath>();
-                if (!apPath.path().isEmpty() && apPath.path() != QStringLiteral("/"))
-                {
-                    QDBusInterface ap(NM_SERVICE, apPath.path(),
-                                      QStringLiteral("org.freedesktop.DBus.Properties"), m_bus);
-                    QDBusReply<QVariant> ssidReply = ap.call(
-                        QStringLiteral("Get"), NM_AP_IFACE, QStringLiteral("Ssid"));
-                    if (ssidReply.isValid())
-                        connectionName = QString::fromUtf8(ssidReply.value().toByteArray());
-                }
-            }
+void
+NetworkSetupPage::fetchActiveSsid(const QDBusObjectPath& devicePath)
+{
+    Device* device = findDevice(devicePath.path());
+    if (!device)
+        return;
+    const QDBusObjectPath path = device->activeAccessPoint;
+    if (path.path().isEmpty() || path.path() == QStringLiteral("/"))
+        return;
+
+    // The list may already know it from the last scan
+    for (const auto& ap : m_accessPoints)
+    {
+        if (ap.path == path)
+        {
+            device->activeSsid = ap.ssid;
+            return;
         }
     }
 
-    // Update UI
-    if (m_isConnected)
+    fetchProperties(path.path(), NM_AP_IFACE, [this, devicePath, path](const QVariantMap& properties) {
+        Device* device = findDevice(devicePath.path());
+        if (!device || path != device->activeAccessPoint)
+            return;
+        device->activeSsid = QString::fromUtf8(properties.value(QStringLiteral("Ssid")).toByteArray());
+        updateConnectionState();
+    });
+}
+
+void
+NetworkSetupPage::updateConnectionState()
+{
+    bool wasConnected = m_isConnected;
+    QString connectionName;
+
+    // NetworkManager routes through a cable before WiFi, so an activated
+    // Ethernet device is what carries the install; the fastest one wins
+    const Device* wired = nullptr;
+    const Device* wireless = nullptr;
+    const Device* cable = nullptr;
+    for (const auto& device : std::as_const(m_devices))
+    {
+        if (device.type == NM_DEVICE_TYPE_ETHERNET && device.carrier && !cable)
+            cable = &device;
+        if (device.state != NM_DEVICE_STATE_ACTIVATED)
+            continue;
+        if (device.type == NM_DEVICE_TYPE_ETHERNET && (!wired || device.speed > wired->speed))
+            wired = &device;
+        else if (device.type == NM_DEVICE_TYPE_WIFI && !wireless)
+            wireless = &device;
+    }
+
+    // NetworkManager's global connectivity catches any existing network
+    // access; the device states are for display
+    if (m_state.connectivity == NM_CONNECTIVITY_FULL)
+    {
+        m_isConnected = true;
+        connectionName = m_state.primaryConnectionId;
+    }
+    else if (wired || wireless)
+    {
+        m_isConnected = true;
+        connectionName = wired ? wired->interface : wireless->activeSsid;
+    }
+    else
+    {
+        m_isConnected = false;
+    }
+    if (m_isConnected && wired && wired->speed > 0)
+        connectionName = tr("%1, %2 Mb/s").arg(connectionName.isEmpty() ? wired->interface : connectionName)
+                             .arg(wired->speed);
+
+    // Update UI; a running attempt shows its own progress until it ends
+    if (m_isConnected && m_connectStart == 0)
     {
         m_statusDot->setStyleSheet(QStringLiteral("color: #4CAF50;"));
         if (!connectionName.isEmpty())
@@ -410,14 +1041,23 @@ NetworkSetupPage::checkConnection()
         else
             m_statusLabel->setText(tr("Connected"));
     }
-    else
+    else if (m_connectStart == 0)
     {
         m_statusDot->setStyleSheet(QStringLiteral("color: #9E9E9E;"));
-        m_statusLabel->setText(tr("Not connected"));
+        if (!m_connectError.isEmpty())
+            m_statusLabel->setText(m_connectError);
+        else if (cable)
+            m_statusLabel->setText(tr("Cable connected on %1, waiting for the network...").arg(cable->interface));
+        else
+            m_statusLabel->setText(tr("Not connected"));
     }
 
     if (wasConnected != m_isConnected)
+    {
+        SetupTrace::instant(m_isConnected ? QStringLiteral("network-up") : QStringLiteral("network-down"),
+                            QStringLiteral("network"));
         emit connectionStateChanged(m_isConnected);
+    }
 }
 
 void
@@ -431,22 +1071,18 @@ void
 NetworkSetupPage::onConnect()
 {
     auto* item = m_networkList->currentItem();
-    if (!item)
+    if (!item || m_connectStart > 0)
         return;
 
-    QString pathStr = item->data(Qt::UserRole).toString();
     QString ssid = item->data(Qt::UserRole + 1).toString();
     bool secured = item->data(Qt::UserRole + 2).toBool();
 
-    QDBusObjectPath apPath(pathStr);
-
     if (!secured)
     {
-        doConnect(apPath, ssid, false, QString());
+        doConnect(ssid, false, QString());
     }
     else
     {
-        m_pendingApPath = apPath;
         m_pendingSsid = ssid;
         m_passwordLabel->setText(QStringLiteral("<b>%1</b>").arg(ssid));
         m_passwordEdit->clear();
@@ -459,7 +1095,7 @@ void
 NetworkSetupPage::onPasswordSubmit()
 {
     m_passwordWidget->hide();
-    doConnect(m_pendingApPath, m_pendingSsid, true, m_passwordEdit->text());
+    doConnect(m_pendingSsid, true, m_passwordEdit->text());
 }
 
 void
@@ -469,33 +1105,234 @@ NetworkSetupPage::onPasswordCancel()
     m_passwordEdit->clear();
 }
 
-// Type alias for NM connection settings: a{sa{sv}}
-using NMVariantMapMap = QMap<QString, QVariantMap>;
-
 void
-NetworkSetupPage::doConnect(const QDBusObjectPath& apPath, const QString& ssid,
-                            bool secured, const QString& password)
+NetworkSetupPage::doConnect(const QString& ssid, bool secured, const QString& password)
 {
     m_statusDot->setStyleSheet(QStringLiteral("color: #FFC107;"));
     m_statusLabel->setText(tr("Connecting..."));
+    m_connectStart = SetupTrace::now();
+    m_connectError.clear();
+    m_connectBtn->setEnabled(false);
+    m_cancelConnectBtn->show();
+    if (m_connectTimeout->interval() > 0)
+        m_connectTimeout->start();
+
+    // A fresh look at just this network picks its strongest access point
+    // and confirms it is still in range
+    m_pendingConnect.ssid = ssid;
+    m_pendingConnect.secured = secured;
+    m_pendingConnect.password = password;
+    m_pendingConnect.active = true;
+    requestScan(ssid);
+}
+
+const AccessPointInfo*
+NetworkSetupPage::bestAccessPoint(const QString& ssid) const
+{
+    // Across every radio, so the one that hears the network best connects
+    const AccessPointInfo* best = nullptr;
+    for (const auto& ap : m_accessPoints)
+    {
+        if (ap.ssid == ssid && (!best || ap.strength > best->strength))
+            best = &ap;
+    }
+    return best;
+}
+
+void
+NetworkSetupPage::activateConnection()
+{
+    const AccessPointInfo* best = bestAccessPoint(m_pendingConnect.ssid);
+    // "/" lets NetworkManager pick one itself
+    const QDBusObjectPath apPath = best ? best->path : QDBusObjectPath(QStringLiteral("/"));
+    QDBusObjectPath device = best ? best->device : QDBusObjectPath();
+    for (const auto& candidate : std::as_const(m_devices))
+    {
+        if (device.path().isEmpty() && candidate.type == NM_DEVICE_TYPE_WIFI)
+            device = candidate.path;
+    }
+    if (device.path().isEmpty())
+    {
+        finishConnect(false, tr("No WiFi adapter found"));
+        return;
+    }
+    m_pendingConnect.device = device;
+    m_pendingConnect.accessPoint = apPath;
+
+    // A profile from an earlier attempt or an earlier run starts without
+    // being created again, and retries do not pile up duplicates
+    const int generation = m_connectGeneration;
+    findSavedConnection(m_pendingConnect.ssid,
+                        [this, generation](const QDBusObjectPath& saved, const NMVariantMapMap& settings) {
+        if (generation != m_connectGeneration)
+            return;
+        if (saved.path().isEmpty())
+            addAndActivateConnection();
+        else if (m_pendingConnect.secured && !m_pendingConnect.password.isEmpty())
+            updateSavedSecrets(saved, settings);
+        else
+            activateSavedConnection(saved);
+    });
+}
+
+void
+NetworkSetupPage::findSavedConnection(const QString& ssid,
+                                      std::function<void(const QDBusObjectPath&, const NMVariantMapMap&)> found)
+{
+    auto* watcher = new QDBusPendingCallWatcher(m_nm->settings()->ListConnections(), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, ssid, found](QDBusPendingCallWatcher* call) {
+        call->deleteLater();
+        QDBusPendingReply<QList<QDBusObjectPath>> reply = *call;
+        if (reply.isError())
+        {
+            cWarning() << "NetworkSetup: ListConnections failed:" << reply.error().message();
+            found(QDBusObjectPath(), NMVariantMapMap());
+            return;
+        }
+
+        // Every profile's settings at once; of those for the SSID, the one
+        // used most recently wins
+        struct Match
+        {
+            QDBusObjectPath path;
+            NMVariantMapMap settings;
+            qulonglong timestamp = 0;
+            int remaining = 0;
+        };
+        const QList<QDBusObjectPath> connections = reply.value();
+        auto match = std::make_shared<Match>();
+        match->remaining = connections.size();
+        if (connections.isEmpty())
+            found(QDBusObjectPath(), NMVariantMapMap());
+        for (const auto& path : connections)
+        {
+            auto* settingsWatcher = new QDBusPendingCallWatcher(m_nm->connection(path)->GetSettings(), this);
+            connect(settingsWatcher, &QDBusPendingCallWatcher::finished, this,
+                    [this, ssid, found, match, path](QDBusPendingCallWatcher* settingsCall) {
+                settingsCall->deleteLater();
+                QDBusPendingReply<NMVariantMapMap> settingsReply = *settingsCall;
+                const NMVariantMapMap settings = settingsReply.isError() ? NMVariantMapMap() : settingsReply.value();
+                const QVariantMap connection = settings.value(QStringLiteral("connection"));
+                const qulonglong timestamp = connection.value(QStringLiteral("timestamp")).toULongLong();
+                const bool matches
+                    = connection.value(QStringLiteral("type")).toString() == QLatin1String("802-11-wireless")
+                    && settings.value(QStringLiteral("802-11-wireless")).value(QStringLiteral("ssid")).toByteArray()
+                        == ssid.toUtf8();
+                if (matches && (match->path.path().isEmpty() || timestamp > match->timestamp))
+                {
+                    if (!match->path.path().isEmpty())
+                        m_nm->forget(match->path.path());
+                    match->path = path;
+                    match->settings = settings;
+                    match->timestamp = timestamp;
+                }
+                else
+                {
+                    m_nm->forget(path.path());
+                }
+                if (--match->remaining == 0)
+                    found(match->path, match->settings);
+            });
+        }
+    });
+}
+
+void
+NetworkSetupPage::updateSavedSecrets(const QDBusObjectPath& saved, const NMVariantMapMap& settings)
+{
+    // Update makes NetworkManager rewrite the profile, so only a password
+    // that differs from the saved one is written back
+    m_pendingConnect.saved = saved;
+    const int generation = m_connectGeneration;
+    auto* watcher = new QDBusPendingCallWatcher(
+        m_nm->connection(saved)->GetSecrets(WIRELESS_SECURITY_SETTING), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this,
+            [this, saved, settings, generation](QDBusPendingCallWatcher* call) {
+        call->deleteLater();
+        QDBusPendingReply<NMVariantMapMap> reply = *call;
+        if (generation != m_connectGeneration)
+            return;
+        // Secrets kept by an agent cannot be read back; those are written too
+        if (!reply.isError()
+            && reply.value().value(WIRELESS_SECURITY_SETTING).value(QStringLiteral("psk")).toString()
+                == m_pendingConnect.password)
+        {
+            activateSavedConnection(saved);
+            return;
+        }
+
+        NMVariantMapMap updated = settings;
+        QVariantMap wireless = updated.value(QStringLiteral("802-11-wireless"));
+        wireless[QStringLiteral("security")] = QString::fromLatin1(WIRELESS_SECURITY_SETTING);
+        updated[QStringLiteral("802-11-wireless")] = wireless;
+        QVariantMap security = updated.value(WIRELESS_SECURITY_SETTING);
+        if (!security.contains(QStringLiteral("key-mgmt")))
+            security[QStringLiteral("key-mgmt")] = QStringLiteral("wpa-psk");
+        security[QStringLiteral("psk")] = m_pendingConnect.password;
+        updated[WIRELESS_SECURITY_SETTING] = security;
+
+        cDebug() << "NetworkSetup: updating the password of" << saved.path();
+        auto* updateWatcher = new QDBusPendingCallWatcher(m_nm->connection(saved)->Update(updated), this);
+        connect(updateWatcher, &QDBusPendingCallWatcher::finished, this,
+                [this, saved, generation](QDBusPendingCallWatcher* updateCall) {
+            updateCall->deleteLater();
+            QDBusPendingReply<> updateReply = *updateCall;
+            if (generation != m_connectGeneration)
+                return;
+            if (updateReply.isError())
+            {
+                cWarning() << "NetworkSetup: Update of" << saved.path() << "failed:" << updateReply.error().message();
+                addAndActivateConnection();
+                return;
+            }
+            activateSavedConnection(saved);
+        });
+    });
+}
+
+void
+NetworkSetupPage::activateSavedConnection(const QDBusObjectPath& saved)
+{
+    cDebug() << "NetworkSetup: reusing saved connection" << saved.path();
+    m_pendingConnect.saved = saved;
+    const int generation = m_connectGeneration;
+    auto* watcher = new QDBusPendingCallWatcher(
+        m_nm->manager()->ActivateConnection(saved, m_pendingConnect.device, m_pendingConnect.accessPoint), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, generation](QDBusPendingCallWatcher* call) {
+        call->deleteLater();
+        QDBusPendingReply<QDBusObjectPath> reply = *call;
+        if (reply.isError())
+        {
+            // The profile may have gone in the meantime; a new one will do
+            cWarning() << "NetworkSetup: ActivateConnection failed:" << reply.error().message();
+            if (generation == m_connectGeneration)
+                addAndActivateConnection();
+            return;
+        }
+        activationStarted(reply.value(), generation);
+    });
+}
 
+void
+NetworkSetupPage::addAndActivateConnection()
+{
     // Build connection settings as a{sa{sv}}
     NMVariantMapMap settings;
 
     // Connection section
     QVariantMap connection;
     connection[QStringLiteral("type")] = QStringLiteral("802-11-wireless");
-    connection[QStringLiteral("id")] = ssid;
+    connection[QStringLiteral("id")] = m_pendingConnect.ssid;
     settings[QStringLiteral("connection")] = connection;
 
     // Wireless section
     QVariantMap wireless;
-    wireless[QStringLiteral("ssid")] = ssid.toUtf8();
+    wireless[QStringLiteral("ssid")] = m_pendingConnect.ssid.toUtf8();
     wireless[QStringLiteral("mode")] = QStringLiteral("infrastructure");
     settings[QStringLiteral("802-11-wireless")] = wireless;
 
     // Security section (if needed)
-    if (secured && !password.isEmpty())
+    if (m_pendingConnect.secured && !m_pendingConnect.password.isEmpty())
     {
         // Also need to reference security in wireless section
         wireless[QStringLiteral("security")] = QStringLiteral("802-11-wireless-security");
@@ -503,7 +1340,7 @@ NetworkSetupPage::doConnect(const QDBusObjectPath& apPath, const QString& ssid,
 
         QVariantMap security;
         security[QStringLiteral("key-mgmt")] = QStringLiteral("wpa-psk");
-        security[QStringLiteral("psk")] = password;
+        security[QStringLiteral("psk")] = m_pendingConnect.password;
         settings[QStringLiteral("802-11-wireless-security")] = security;
     }
 
@@ -517,44 +1354,134 @@ NetworkSetupPage::doConnect(const QDBusObjectPath& apPath, const QString& ssid,
     ipv6[QStringLiteral("method")] = QStringLiteral("auto");
     settings[QStringLiteral("ipv6")] = ipv6;
 
-    // Use AddAndActivateConnection
-    QDBusInterface nm(NM_SERVICE, NM_PATH, NM_IFACE, m_bus);
-    if (!nm.isValid())
+    // NetworkManager replies once the attempt has started; how it goes is
+    // reported by the returned ActiveConnection
+    const int generation = m_connectGeneration;
+    auto* watcher = new QDBusPendingCallWatcher(
+        m_nm->manager()->AddAndActivateConnection(settings, m_pendingConnect.device, m_pendingConnect.accessPoint),
+        this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, generation](QDBusPendingCallWatcher* call) {
+        call->deleteLater();
+        QDBusPendingReply<QDBusObjectPath, QDBusObjectPath> reply = *call;
+        if (reply.isError())
+        {
+            cWarning() << "NetworkSetup: AddAndActivateConnection failed:" << reply.error().message();
+            if (generation == m_connectGeneration)
+                finishConnect(false, reply.error().message());
+            return;
+        }
+        activationStarted(reply.argumentAt<1>(), generation);
+    });
+}
+
+void
+NetworkSetupPage::activationStarted(const QDBusObjectPath& activation, int generation)
+{
+    if (generation != m_connectGeneration)
     {
-        QMessageBox::warning(this, tr("Error"), tr("NetworkManager not available"));
+        // Cancelled or timed out while NetworkManager was starting it
+        deactivateConnection(activation);
         return;
     }
+    cDebug() << "NetworkSetup: activating" << activation.path();
+    watchActivation(activation);
+}
 
-    // Build the D-Bus message manually for correct typing
-    QDBusMessage msg = QDBusMessage::createMethodCall(
-        NM_SERVICE, NM_PATH, NM_IFACE, QStringLiteral("AddAndActivateConnection"));
+void
+NetworkSetupPage::watchActivation(const QDBusObjectPath& path)
+{
+    unwatch(m_activationWatcher);
+    m_activation = path;
+    m_activationWatcher = new NMObjectWatcher(path.path(), m_bus, this);
+    connect(m_activationWatcher, &NMObjectWatcher::activationStateChanged, this,
+            &NetworkSetupPage::applyActivationState);
+    m_activationWatcher->watchActivationState();
+
+    // It may have got somewhere before the subscription was in place
+    const int generation = m_connectGeneration;
+    fetchProperties(path.path(), NM_ACTIVE_IFACE, [this, generation](const QVariantMap& properties) {
+        if (generation == m_connectGeneration)
+            applyActivationState(properties.value(QStringLiteral("State")).toUInt(), 0);
+    });
+}
 
-    // Serialize settings as a{sa{sv}}
-    QDBusArgument arg;
-    arg.beginMap(QMetaType::fromType<QString>(), QMetaType::fromType<QVariantMap>());
-    for (auto it = settings.constBegin(); it != settings.constEnd(); ++it)
+void
+NetworkSetupPage::applyActivationState(uint state, uint reason)
+{
+    if (state == NM_ACTIVE_CONNECTION_STATE_ACTIVATED)
+    {
+        cDebug() << "NetworkSetup: connection activated";
+        finishConnect(true);
+    }
+    else if (state == NM_ACTIVE_CONNECTION_STATE_DEACTIVATED)
     {
-        arg.beginMapEntry();
-        arg << it.key() << it.value();
-        arg.endMapEntry();
+        cWarning() << "NetworkSetup: connection deactivated, reason" << reason;
+        finishConnect(false, tr("Connection failed"));
     }
-    arg.endMap();
+}
 
-    msg << QVariant::fromValue(arg);
-    msg << QVariant::fromValue(m_wirelessDevice);
-    msg << QVariant::fromValue(apPath);
+void
+NetworkSetupPage::onConnectTimeout()
+{
+    if (m_connectStart == 0)
+        return;
+    cWarning() << "NetworkSetup: connecting to" << m_pendingConnect.ssid << "timed out";
+    const QDBusObjectPath activation = m_activation;
+    finishConnect(false, tr("Connecting to %1 timed out").arg(m_pendingConnect.ssid));
+    deactivateConnection(activation);
+}
 
-    QDBusMessage reply = m_bus.call(msg);
+void
+NetworkSetupPage::onCancelConnect()
+{
+    if (m_connectStart == 0)
+        return;
+    const QDBusObjectPath activation = m_activation;
+    finishConnect(false, tr("Connection cancelled"));
+    deactivateConnection(activation);
+}
 
-    if (reply.type() == QDBusMessage::ErrorMessage)
-    {
-        cWarning() << "NetworkSetup: AddAndActivateConnection failed:" << reply.errorMessage();
-        QMessageBox::warning(this, tr("Error"), reply.errorMessage());
-        m_statusDot->setStyleSheet(QStringLiteral("color: #9E9E9E;"));
-        m_statusLabel->setText(tr("Connection failed"));
+void
+NetworkSetupPage::deactivateConnection(const QDBusObjectPath& path)
+{
+    if (path.path().isEmpty() || path.path() == QStringLiteral("/"))
         return;
+
+    auto* watcher = new QDBusPendingCallWatcher(m_nm->manager()->DeactivateConnection(path), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [](QDBusPendingCallWatcher* call) {
+        call->deleteLater();
+        QDBusPendingReply<> reply = *call;
+        // Usually it had already failed on its own
+        if (reply.isError())
+            cDebug() << "NetworkSetup: DeactivateConnection:" << reply.error().message();
+    });
+}
+
+void
+NetworkSetupPage::finishConnect(bool ok, const QString& error)
+{
+    if (m_connectStart == 0)
+        return;
+
+    SetupTrace::complete(QStringLiteral("wifi-connect"), QStringLiteral("network"), m_connectStart,
+                         { { QStringLiteral("ok"), ok } });
+    m_connectStart = 0;
+    ++m_connectGeneration;
+    m_connectTimeout->stop();
+    if (!m_pendingConnect.saved.path().isEmpty())
+        m_nm->forget(m_pendingConnect.saved.path());
+    m_pendingConnect = PendingConnect();
+    m_connectError = error;
+
+    if (!m_activation.path().isEmpty())
+    {
+        unwatch(m_activationWatcher);
+        if (m_activation != m_watchedConnection)
+            m_nm->forget(m_activation.path());
     }
+    m_activation = QDBusObjectPath();
 
-    cDebug() << "NetworkSetup: connection activated";
-    QTimer::singleShot(3000, this, &NetworkSetupPage::loadAccessPoints);
+    m_cancelConnectBtn->hide();
+    m_connectBtn->setEnabled(true);
+    updateConnectionState();
 }
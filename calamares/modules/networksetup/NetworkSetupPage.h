@@ -7,7 +7,12 @@
 
 #include <QWidget>
 #include <QDBusConnection>
+#include <QDBusMessage>
 #include <QDBusObjectPath>
+#include <QMap>
+#include <QVariantMap>
+
+#include <functional>
 
 class QLabel;
 class QLineEdit;
@@ -15,10 +20,15 @@ class QTimer;
 class QListWidget;
 class QListWidgetItem;
 class QPushButton;
+class QCheckBox;
+class QDBusServiceWatcher;
+class NetworkManagerClient;
+class NMObjectWatcher;
 
 struct AccessPointInfo
 {
     QDBusObjectPath path;
+    QDBusObjectPath device;     // the device that sees it
     QString ssid;
     uint strength;
     uint flags;      // NM_802_11_AP_FLAGS
@@ -27,6 +37,14 @@ struct AccessPointInfo
     bool secured;
 };
 
+// What NetworkManager last told us; kept current by its signals
+struct NetworkState
+{
+    uint connectivity = 0;           // NM_CONNECTIVITY
+    QDBusObjectPath primaryConnection;
+    QString primaryConnectionId;
+};
+
 class NetworkSetupPage : public QWidget
 {
     Q_OBJECT
@@ -37,50 +55,178 @@ public:
 
     bool isConnected() const { return m_isConnected; }
 
+    // Tick the offline install box, if the media offers it
+    void setOfflineInstall(bool offline);
+
+    // How long a connection attempt may take; 0 waits for NetworkManager
+    void setConnectTimeout(int seconds);
+
 signals:
     void connectionStateChanged(bool connected);
+    void offlineInstallChanged(bool offline);
 
 private slots:
     void scan();
-    void loadAccessPoints();
     void onConnect();
     void onItemDoubleClicked(QListWidgetItem* item);
-    void checkConnection();
+    void onManagerPropertiesChanged(const QString& interface, const QVariantMap& changed,
+                                    const QStringList& invalidated);
+    void onManagerStateChanged(uint state);
+    void onDeviceAdded(const QDBusObjectPath& path);
+    void onDeviceRemoved(const QDBusObjectPath& path);
+    // Subscribed for every access point at once, so the path comes
+    // with the message
+    void onAccessPointPropertiesChanged(const QString& interface, const QVariantMap& changed,
+                                        const QStringList& invalidated, const QDBusMessage& message);
+    void scanFinished();
+    void onConnectTimeout();
+    void onCancelConnect();
     void onPasswordSubmit();
     void onPasswordCancel();
 
 private:
+    // The device's LastScan, which changes when scan results are in
+    static constexpr qint64 LAST_SCAN_UNKNOWN = -2;
+
+    // A WiFi or Ethernet device and what NetworkManager last said about it
+    struct Device
+    {
+        QDBusObjectPath path;
+        uint type = 0;              // NM_DEVICE_TYPE
+        QString interface;
+        uint state = 0;             // NM_DEVICE_STATE
+        // WiFi
+        qint64 lastScan = LAST_SCAN_UNKNOWN;
+        bool scanning = false;
+        QDBusObjectPath activeAccessPoint;
+        QString activeSsid;
+        // Ethernet
+        bool carrier = false;
+        uint speed = 0;             // Mb/s
+        NMObjectWatcher* watcher = nullptr;
+    };
+
     void setupUi();
-    void findWirelessDevice();
+    void findDevices();
+    void useDevices(const QList<QDBusObjectPath>& devices, const QList<uint>& types);
+    void addDevice(const QDBusObjectPath& path, uint type);
+    Device* findDevice(const QString& path);
+    bool hasWirelessDevice() const;
+    void watchNetworkManager();
+    void watchDevice(Device& device);
+    void unwatchDevice(Device& device);
+    void unwatch(NMObjectWatcher*& watcher);
+    void watchActiveConnection(const QDBusObjectPath& path);
+    void onActiveConnectionPropertiesChanged(const QString& interface, const QVariantMap& changed);
+    void onDeviceStateChanged(const QDBusObjectPath& path, uint newState, uint reason);
+    void onAccessPointAdded(const QDBusObjectPath& device, const QDBusObjectPath& path);
+    void onAccessPointRemoved(const QDBusObjectPath& path);
+    void applyManagerProperties(const QVariantMap& properties);
+    void applyDeviceProperties(const QDBusObjectPath& path, const QVariantMap& properties);
+    void fetchActiveSsid(const QDBusObjectPath& device);
+    void fetchProperties(const QString& path, const QString& interface,
+                         std::function<void(const QVariantMap&)> apply,
+                         std::function<void()> failed = {});
+    void loadAccessPoints(const QDBusObjectPath& device);
+    void accessPointLoaded();
+    void updateAccessPoint(const QDBusObjectPath& device, const QDBusObjectPath& path,
+                           const QVariantMap& properties);
+    void finishScan();
+    void scheduleListUpdate();
+    void updateConnectionState();
     void updateList();
-    void doConnect(const QDBusObjectPath& apPath, const QString& ssid, bool secured, const QString& password);
+    void requestScan(const QString& ssid);
+    void requestDeviceScan(const QDBusObjectPath& device);
+    void deviceScanFinished(const QDBusObjectPath& device);
+    void doConnect(const QString& ssid, bool secured, const QString& password);
+    void activateConnection();
+    void findSavedConnection(const QString& ssid,
+                             std::function<void(const QDBusObjectPath&, const QMap<QString, QVariantMap>&)> found);
+    void updateSavedSecrets(const QDBusObjectPath& saved, const QMap<QString, QVariantMap>& settings);
+    void activateSavedConnection(const QDBusObjectPath& saved);
+    void addAndActivateConnection();
+    void activationStarted(const QDBusObjectPath& activation, int generation);
+    void watchActivation(const QDBusObjectPath& path);
+    void applyActivationState(uint state, uint reason);
+    void deactivateConnection(const QDBusObjectPath& path);
+    void finishConnect(bool ok, const QString& error = QString());
+    const AccessPointInfo* bestAccessPoint(const QString& ssid) const;
 
     QLabel* m_statusDot;
     QLabel* m_statusLabel;
     QListWidget* m_networkList;
     QPushButton* m_scanBtn;
     QPushButton* m_connectBtn;
+    QPushButton* m_cancelConnectBtn;
+    QCheckBox* m_offlineCheck = nullptr;
 
     // Inline password entry
     QWidget* m_passwordWidget;
     QLabel* m_passwordLabel;
     QLineEdit* m_passwordEdit;
     QPushButton* m_passwordOkBtn;
-    QDBusObjectPath m_pendingApPath;
     QString m_pendingSsid;
 
+    // Held from the targeted scan before connecting until the attempt ends
+    struct PendingConnect
+    {
+        bool active = false;
+        QString ssid;
+        bool secured = false;
+        QString password;
+        // The device it runs on and the access point, once the scan has
+        // picked them
+        QDBusObjectPath device;
+        QDBusObjectPath accessPoint;
+        // The saved profile being reused, if there is one
+        QDBusObjectPath saved;
+    };
+    PendingConnect m_pendingConnect;
+
     QDBusConnection m_bus;
-    QDBusObjectPath m_wirelessDevice;
+    NetworkManagerClient* m_nm;
+    QList<Device> m_devices;
+    // Replies to device queries from before a NetworkManager restart are ignored
+    int m_deviceGeneration = 0;
+    // Every radio's access points, merged by SSID in the list
     QList<AccessPointInfo> m_accessPoints;
+    // Replies to access point queries from before a restart are ignored
+    int m_loadGeneration = 0;
+    // Access point lists and properties still to come in
+    int m_pendingAccessPoints = 0;
+    QTimer* m_listUpdateTimer = nullptr;
+    // A scan runs until every radio has reported
+    bool m_scanning = false;
+    QString m_scanSsid;
+    QTimer* m_scanTimeout = nullptr;
     bool m_isConnected = false;
-    QTimer* m_connectionCheckTimer = nullptr;
+    // SetupTrace::now() when the pending scan or connection attempt began
+    qint64 m_scanStart = 0;
+    qint64 m_connectStart = 0;
+    // The ActiveConnection of the running attempt, once NetworkManager
+    // has accepted it
+    QDBusObjectPath m_activation;
+    NMObjectWatcher* m_activationWatcher = nullptr;
+    // Replies for an attempt that was cancelled or timed out are ignored
+    int m_connectGeneration = 0;
+    QTimer* m_connectTimeout = nullptr;
+    // Why the last attempt failed; shown until the next one
+    QString m_connectError;
+    NetworkState m_state;
+    // Where the active connection's signals are subscribed from
+    QDBusObjectPath m_watchedConnection;
+    NMObjectWatcher* m_connectionWatcher = nullptr;
+    QDBusServiceWatcher* m_serviceWatcher = nullptr;
 
     static constexpr const char* NM_SERVICE = "org.freedesktop.NetworkManager";
     static constexpr const char* NM_PATH = "/org/freedesktop/NetworkManager";
     static constexpr const char* NM_IFACE = "org.freedesktop.NetworkManager";
     static constexpr const char* NM_DEVICE_IFACE = "org.freedesktop.NetworkManager.Device";
     static constexpr const char* NM_WIRELESS_IFACE = "org.freedesktop.NetworkManager.Device.Wireless";
+    static constexpr const char* NM_WIRED_IFACE = "org.freedesktop.NetworkManager.Device.Wired";
     static constexpr const char* NM_AP_IFACE = "org.freedesktop.NetworkManager.AccessPoint";
+    static constexpr const char* NM_ACTIVE_IFACE = "org.freedesktop.NetworkManager.Connection.Active";
+    static constexpr const char* DBUS_PROPERTIES_IFACE = "org.freedesktop.DBus.Properties";
 };
 
 #endif // NETWORKSETUPPAGE_H
@@ -3,23 +3,62 @@
  */
 
 #include "NetworkSetupViewStep.h"
+#include "MirrorRanker.h"
 #include "NetworkSetupPage.h"
+#include "PackageDatabaseSync.h"
+#include "SetupJournal.h"
+#include "SetupTrace.h"
 
+#include "GlobalStorage.h"
+#include "JobQueue.h"
 #include "utils/Logger.h"
 
+// Setup journal entry for the offline install choice
+static const QString JOURNAL_SECTION = QStringLiteral("networksetup");
+static const QString OFFLINE_KEY = QStringLiteral("offlineRequested");
+
 CALAMARES_PLUGIN_FACTORY_DEFINITION(NetworkSetupViewStepFactory, registerPlugin<NetworkSetupViewStep>();)
 
 NetworkSetupViewStep::NetworkSetupViewStep(QObject* parent)
     : Calamares::ViewStep(parent)
     , m_widget(new NetworkSetupPage())
+    , m_dbSync(new PackageDatabaseSync(this))
+    , m_mirrorRanker(new MirrorRanker(this))
 {
     cDebug() << "NetworkSetup viewstep created";
+    SetupTrace::instant(QStringLiteral("networksetup-loaded"), QStringLiteral("module"));
+    // The network page is where the installer has been seen to freeze
+    SetupTrace::watchEventLoop(this);
 
     connect(m_widget, &NetworkSetupPage::connectionStateChanged,
             this, &NetworkSetupViewStep::onConnectionStateChanged);
-
-    // Check initial connection state
-    m_isConnected = m_widget->isConnected();
+    connect(m_widget, &NetworkSetupPage::offlineInstallChanged,
+            this, &NetworkSetupViewStep::onOfflineInstallChanged);
+
+    // The sync waits for the probes so it does not skew their measurements
+    // and syncs from the fastest of them
+    connect(m_mirrorRanker, &MirrorRanker::finished, this, [this](bool ranked) {
+        auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+        if (gs && m_mirrorRanker->bestThroughput() > 0)
+            gs->insert(QStringLiteral("mirrorThroughput"), m_mirrorRanker->bestThroughput());
+        if (ranked)
+            m_dbSync->setMirrorlist(MirrorRanker::mirrorlist(), MirrorRanker::rankedMirrorlist());
+        m_dbSync->start();
+    });
+
+    // Lets the desktop page recompute its package sizes
+    connect(m_dbSync, &PackageDatabaseSync::finished, this, [](bool ok) {
+        auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+        if (ok && gs)
+            gs->insert(QStringLiteral("packageDatabasesSynced"), true);
+    });
+
+    // Keep the choice made before an interrupted earlier run
+    if (SetupJournal::value(JOURNAL_SECTION, OFFLINE_KEY).toBool())
+        m_widget->setOfflineInstall(true);
+
+    // The page learns the connection state from NetworkManager replies
+    // that come later; connectionStateChanged reports it
 }
 
 NetworkSetupViewStep::~NetworkSetupViewStep()
@@ -45,7 +84,7 @@ NetworkSetupViewStep::widget()
 bool
 NetworkSetupViewStep::isNextEnabled() const
 {
-    return m_isConnected;
+    return m_isConnected || m_offlineRequested;
 }
 
 bool
@@ -73,15 +112,64 @@ NetworkSetupViewStep::jobs() const
     return Calamares::JobList();
 }
 
+void
+NetworkSetupViewStep::onActivate()
+{
+    m_activatedAt = SetupTrace::now();
+}
+
+void
+NetworkSetupViewStep::onLeave()
+{
+    if (m_activatedAt > 0)
+        SetupTrace::complete(QStringLiteral("page-networksetup"), QStringLiteral("page"), m_activatedAt,
+                             { { QStringLiteral("connected"), m_isConnected },
+                               { QStringLiteral("offline"), m_offlineRequested && !m_isConnected } });
+    m_activatedAt = 0;
+}
+
 void
 NetworkSetupViewStep::setConfigurationMap(const QVariantMap& configurationMap)
 {
-    Q_UNUSED(configurationMap)
+    const auto timeout = configurationMap.constFind(QStringLiteral("connectTimeout"));
+    if (timeout != configurationMap.constEnd())
+        m_widget->setConnectTimeout(timeout->toInt());
 }
 
 void
 NetworkSetupViewStep::onConnectionStateChanged(bool connected)
 {
     m_isConnected = connected;
-    emit nextStatusChanged(connected);
+    publishOfflineInstall();
+    emit nextStatusChanged(isNextEnabled());
+
+    // Get the database download off the install step's critical path
+    if (connected)
+        startBackgroundWork();
+}
+
+void
+NetworkSetupViewStep::onOfflineInstallChanged(bool offline)
+{
+    m_offlineRequested = offline;
+    SetupJournal::insert(JOURNAL_SECTION, OFFLINE_KEY, offline);
+    publishOfflineInstall();
+    emit nextStatusChanged(isNextEnabled());
+}
+
+void
+NetworkSetupViewStep::publishOfflineInstall()
+{
+    // A working connection wins; the local repository is the fallback
+    auto* gs = Calamares::JobQueue::instanceGlobalStorage();
+    if (gs)
+        gs->insert(QStringLiteral("offlineInstall"), m_offlineRequested && !m_isConnected);
+}
+
+void
+NetworkSetupViewStep::startBackgroundWork()
+{
+    m_mirrorRanker->start();
+    if (!m_mirrorRanker->isRunning())
+        m_dbSync->start();
 }
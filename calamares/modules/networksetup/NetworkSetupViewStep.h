@@ -14,6 +14,8 @@
 #include <QObject>
 
 class NetworkSetupPage;
+class PackageDatabaseSync;
+class MirrorRanker;
 
 class PLUGINDLLEXPORT NetworkSetupViewStep : public Calamares::ViewStep
 {
@@ -33,14 +35,25 @@ public:
 
     Calamares::JobList jobs() const override;
 
+    void onActivate() override;
+    void onLeave() override;
+
     void setConfigurationMap(const QVariantMap& configurationMap) override;
 
 private slots:
     void onConnectionStateChanged(bool connected);
+    void onOfflineInstallChanged(bool offline);
 
 private:
+    void startBackgroundWork();
+    void publishOfflineInstall();
+
     NetworkSetupPage* m_widget;
+    PackageDatabaseSync* m_dbSync;
+    MirrorRanker* m_mirrorRanker;
     bool m_isConnected = false;
+    bool m_offlineRequested = false;
+    qint64 m_activatedAt = 0;
 };
 
 CALAMARES_PLUGIN_FACTORY_DECLARATION(NetworkSetupViewStepFactory)
@@ -0,0 +1,180 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ */
+
+#include "PackageDatabaseSync.h"
+
+#include "DatabaseSync.h"
+#include "SetupTrace.h"
+
+#include "utils/Logger.h"
+
+#include <QFile>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QTimer>
+
+#include <signal.h>
+#include <sys/types.h>
+
+// Give up waiting for another pacman after this many retries
+constexpr int MAX_LOCK_RETRIES = 24;
+constexpr int LOCK_RETRY_MS = 5000;
+
+constexpr const char* PACMAN_CONF = "/etc/pacman.conf";
+
+PackageDatabaseSync::PackageDatabaseSync(QObject* parent)
+    : QObject(parent)
+    , m_retryTimer(new QTimer(this))
+{
+    m_retryTimer->setSingleShot(true);
+    m_retryTimer->setInterval(LOCK_RETRY_MS);
+    connect(m_retryTimer, &QTimer::timeout, this, &PackageDatabaseSync::start);
+}
+
+PackageDatabaseSync::~PackageDatabaseSync()
+{
+    if (m_process && m_process->state() != QProcess::NotRunning)
+    {
+        // SIGINT lets pacman remove its lock file before exiting
+        m_process->disconnect(this);
+        ::kill(static_cast<pid_t>(m_process->processId()), SIGINT);
+        if (!m_process->waitForFinished(5000))
+            m_process->kill();
+    }
+}
+
+void
+PackageDatabaseSync::setMirrorlist(const QString& mirrorlist, const QString& replacement)
+{
+    m_mirrorlist = mirrorlist;
+    m_replacementMirrorlist = replacement;
+}
+
+void
+PackageDatabaseSync::start()
+{
+    if (m_process || m_synced || m_retryTimer->isActive())
+        return;
+
+    if (QFile::exists(QStringLiteral("/var/lib/pacman/db.lck")))
+    {
+        if (++m_lockRetries > MAX_LOCK_RETRIES)
+        {
+            cWarning() << "NetworkSetup: pacman database stays locked, skipping background sync";
+            return;
+        }
+        m_retryTimer->start();
+        return;
+    }
+    m_lockRetries = 0;
+
+    cDebug() << "NetworkSetup: starting background package database sync";
+
+    m_startTime = SetupTrace::now();
+    m_process = new QProcess(this);
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &PackageDatabaseSync::onProcessFinished);
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart)
+            onProcessFinished(-1, QProcess::CrashExit);
+    });
+    QStringList args { QStringLiteral("-Sy"),
+                       QStringLiteral("--noconfirm"),
+                       QStringLiteral("--disable-download-timeout") };
+    // The ranked mirrors are what the sync waited for. de-packages
+    // downloads with the same file, so one left by an earlier run goes.
+    if (!m_replacementMirrorlist.isEmpty() && writeConfig())
+        args << QStringLiteral("--config") << DatabaseSync::configFile();
+    else
+        QFile::remove(DatabaseSync::configFile());
+    m_process->start(QStringLiteral("pacman"), args);
+}
+
+void
+PackageDatabaseSync::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    const bool ok = exitStatus == QProcess::NormalExit && exitCode == 0;
+
+    if (m_process)
+    {
+        if (!ok)
+            cWarning() << "NetworkSetup: background database sync failed:"
+                       << m_process->readAllStandardError().trimmed();
+        m_process->deleteLater();
+        m_process = nullptr;
+        SetupTrace::complete(QStringLiteral("database-sync"), QStringLiteral("network"), m_startTime,
+                             { { QStringLiteral("ok"), ok } });
+    }
+
+    if (ok)
+    {
+        cDebug() << "NetworkSetup: package databases synchronized";
+        m_synced = true;
+        writeStamp();
+    }
+
+    emit finished(ok);
+}
+
+void
+PackageDatabaseSync::writeStamp()
+{
+    // The de-packages install job skips its forced refresh when this matches
+    // the session ID exported by first-time-setup-cage.sh
+    const QByteArray session = qgetenv("ASAHI_SETUP_SESSION");
+    if (session.isEmpty())
+        return;
+
+    QSaveFile stamp(DatabaseSync::stampFile());
+    if (stamp.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        stamp.write(session);
+        stamp.commit();
+    }
+    else
+    {
+        cWarning() << "NetworkSetup: could not write" << DatabaseSync::stampFile() << stamp.errorString();
+    }
+}
+
+bool
+PackageDatabaseSync::writeConfig()
+{
+    QFile original(QString::fromLatin1(PACMAN_CONF));
+    if (!original.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        cWarning() << "NetworkSetup: cannot read" << PACMAN_CONF << original.errorString();
+        return false;
+    }
+
+    QSaveFile file(DatabaseSync::configFile());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        cWarning() << "NetworkSetup: could not write" << DatabaseSync::configFile() << file.errorString();
+        return false;
+    }
+
+    // Everything else stays as configured, including the database path
+    static const QRegularExpression includeLine(QStringLiteral("^\\s*Include\\s*=\\s*(\\S+)\\s*$"));
+    QTextStream in(&original);
+    QTextStream out(&file);
+    while (!in.atEnd())
+    {
+        const QString line = in.readLine();
+        const auto match = includeLine.match(line);
+        if (match.hasMatch() && match.captured(1) == m_mirrorlist)
+            out << "Include = " << m_replacementMirrorlist << "\n";
+        else
+            out << line << "\n";
+    }
+    out.flush();
+
+    if (!file.commit())
+    {
+        cWarning() << "NetworkSetup: could not write" << DatabaseSync::configFile() << file.errorString();
+        return false;
+    }
+    return true;
+}
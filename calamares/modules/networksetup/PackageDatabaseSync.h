@@ -0,0 +1,51 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Background pacman sync-database refresh, started as soon as the
+ * network comes up so the install step does not have to wait for it.
+ */
+
+#ifndef PACKAGEDATABASESYNC_H
+#define PACKAGEDATABASESYNC_H
+
+#include <QObject>
+#include <QProcess>
+
+class QTimer;
+
+class PackageDatabaseSync : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PackageDatabaseSync(QObject* parent = nullptr);
+    ~PackageDatabaseSync() override;
+
+    // Start a sync unless one is running or already succeeded this session
+    void start();
+
+    bool isSynced() const { return m_synced; }
+
+    // Sync from replacement wherever pacman.conf includes mirrorlist
+    void setMirrorlist(const QString& mirrorlist, const QString& replacement);
+
+signals:
+    void finished(bool success);
+
+private:
+    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void writeStamp();
+    bool writeConfig();
+
+    QProcess* m_process = nullptr;
+    qint64 m_startTime = 0;
+    // Waits out another pacman's lock; one retry at a time however often
+    // start() is called meanwhile
+    QTimer* m_retryTimer;
+    int m_lockRetries = 0;
+    QString m_mirrorlist;
+    QString m_replacementMirrorlist;
+    bool m_synced = false;
+};
+
+#endif // PACKAGEDATABASESYNC_H
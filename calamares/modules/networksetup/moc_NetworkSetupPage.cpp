@@ -1,145 +0,0 @@
-/****************************************************************************
-** Meta object code from reading C++ file 'NetworkSetupPage.h'
-**
-** Created by: The Qt Meta Object Compiler version 69 (Qt 6.10.1)
-**
-** WARNING! All changes made in this file will be lost!
-*****************************************************************************/
-
-#include "NetworkSetupPage.h"
-#include <QtCore/qmetatype.h>
-
-#include <QtCore/qtmochelpers.h>
-
-#include <memory>
-
-
-#include <QtCore/qxptype_traits.h>
-#if !defined(Q_MOC_OUTPUT_REVISION)
-#error "The header file 'NetworkSetupPage.h' doesn't include <QObject>."
-#elif Q_MOC_OUTPUT_REVISION != 69
-#error "This file was generated using the moc from 6.10.1. It"
-#error "cannot be used with the include files from this version of Qt."
-#error "(The moc has changed too much.)"
-#endif
-
-#ifndef Q_CONSTINIT
-#define Q_CONSTINIT
-#endif
-
-QT_WARNING_PUSH
-QT_WARNING_DISABLE_DEPRECATED
-QT_WARNING_DISABLE_GCC("-Wuseless-cast")
-namespace {
-struct qt_meta_tag_ZN16NetworkSetupPageE_t {};
-} // unnamed namespace
-
-template <> constexpr inline auto NetworkSetupPage::qt_create_metaobjectdata<qt_meta_tag_ZN16NetworkSetupPageE_t>()
-{
-    namespace QMC = QtMocConstants;
-    QtMocHelpers::StringRefStorage qt_stringData {
-        "NetworkSetupPage",
-        "connectionStateChanged",
-        "",
-        "connected",
-        "scan",
-        "loadAccessPoints",
-        "onConnect",
-        "onItemDoubleClicked",
-        "QListWidgetItem*",
-        "item",
-        "checkConnection"
-    };
-
-    QtMocHelpers::UintData qt_methods {
-        // Signal 'connectionStateChanged'
-        QtMocHelpers::SignalData<void(bool)>(1, 2, QMC::AccessPublic, QMetaType::Void, {{
-            { QMetaType::Bool, 3 },
-        }}),
-        // Slot 'scan'
-        QtMocHelpers::SlotData<void()>(4, 2, QMC::AccessPrivate, QMetaType::Void),
-        // Slot 'loadAccessPoints'
-        QtMocHelpers::SlotData<void()>(5, 2, QMC::AccessPrivate, QMetaType::Void),
-        // Slot 'onConnect'
-        QtMocHelpers::SlotData<void()>(6, 2, QMC::AccessPrivate, QMetaType::Void),
-        // Slot 'onItemDoubleClicked'
-        QtMocHelpers::SlotData<void(QListWidgetItem *)>(7, 2, QMC::AccessPrivate, QMetaType::Void, {{
-            { 0x80000000 | 8, 9 },
-        }}),
-        // Slot 'checkConnection'
-        QtMocHelpers::SlotData<void()>(10, 2, QMC::AccessPrivate, QMetaType::Void),
-    };
-    QtMocHelpers::UintData qt_properties {
-    };
-    QtMocHelpers::UintData qt_enums {
-    };
-    return QtMocHelpers::metaObjectData<NetworkSetupPage, qt_meta_tag_ZN16NetworkSetupPageE_t>(QMC::MetaObjectFlag{}, qt_stringData,
-            qt_methods, qt_properties, qt_enums);
-}
-Q_CONSTINIT const QMetaObject NetworkSetupPage::staticMetaObject = { {
-    QMetaObject::SuperData::link<QWidget::staticMetaObject>(),
-    qt_staticMetaObjectStaticContent<qt_meta_tag_ZN16NetworkSetupPageE_t>.stringdata,
-    qt_staticMetaObjectStaticContent<qt_meta_tag_ZN16NetworkSetupPageE_t>.data,
-    qt_static_metacall,
-    nullptr,
-    qt_staticMetaObjectRelocatingContent<qt_meta_tag_ZN16NetworkSetupPageE_t>.metaTypes,
-    nullptr
-} };
-
-void NetworkSetupPage::qt_static_metacall(QObject *_o, QMetaObject::Call _c, int _id, void **_a)
-{
-    auto *_t = static_cast<NetworkSetupPage *>(_o);
-    if (_c == QMetaObject::InvokeMetaMethod) {
-        switch (_id) {
-        case 0: _t->connectionStateChanged((*reinterpret_cast<std::add_pointer_t<bool>>(_a[1]))); break;
-        case 1: _t->scan(); break;
-        case 2: _t->loadAccessPoints(); break;
-        case 3: _t->onConnect(); break;
-        case 4: _t->onItemDoubleClicked((*reinterpret_cast<std::add_pointer_t<QListWidgetItem*>>(_a[1]))); break;
-        case 5: _t->checkConnection(); break;
-        default: ;
-        }
-    }
-    if (_c == QMetaObject::IndexOfMethod) {
-        if (QtMocHelpers::indexOfMethod<void (NetworkSetupPage::*)(bool )>(_a, &NetworkSetupPage::connectionStateChanged, 0))
-            return;
-    }
-}
-
-const QMetaObject *NetworkSetupPage::metaObject() const
-{
-    return QObject::d_ptr->metaObject ? QObject::d_ptr->dynamicMetaObject() : &staticMetaObject;
-}
-
-void *NetworkSetupPage::qt_metacast(const char *_clname)
-{
-    if (!_clname) return nullptr;
-    if (!strcmp(_clname, qt_staticMetaObjectStaticContent<qt_meta_tag_ZN16NetworkSetupPageE_t>.strings))
-        return static_cast<void*>(this);
-    return QWidget::qt_metacast(_clname);
-}
-
-int NetworkSetupPage::qt_metacall(QMetaObject::Call _c, int _id, void **_a)
-{
-    _id = QWidget::qt_metacall(_c, _id, _a);
-    if (_id < 0)
-        return _id;
-    if (_c == QMetaObject::InvokeMetaMethod) {
-        if (_id < 6)
-            qt_static_metacall(this, _c, _id, _a);
-        _id -= 6;
-    }
-    if (_c == QMetaObject::RegisterMethodArgumentMetaType) {
-        if (_id < 6)
-            *reinterpret_cast<QMetaType *>(_a[0]) = QMetaType();
-        _id -= 6;
-    }
-    return _id;
-}
-
-// SIGNAL 0
-void NetworkSetupPage::connectionStateChanged(bool _t1)
-{
-    QMetaObject::activate<void>(this, &staticMetaObject, 0, nullptr, _t1);
-}
-QT_WARNING_POP
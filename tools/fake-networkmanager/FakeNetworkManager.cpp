@@ -0,0 +1,707 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * A stand-in for NetworkManager with the objects, methods and signals
+ * the networksetup page uses, so the page can be run and timed without
+ * WiFi hardware. It claims org.freedesktop.NetworkManager on the bus
+ * DBUS_SYSTEM_BUS_ADDRESS names; run-with-fake-nm.sh starts a private
+ * bus for it.
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusObjectPath>
+#include <QDBusVariant>
+#include <QDBusVirtualObject>
+#include <QDateTime>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QTextStream>
+#include <QTimer>
+#include <QUuid>
+
+#include <algorithm>
+#include <cstdio>
+
+// NM connection settings: a{sa{sv}}
+using NMVariantMapMap = QMap<QString, QVariantMap>;
+Q_DECLARE_METATYPE(NMVariantMapMap)
+
+constexpr const char* NM_SERVICE = "org.freedesktop.NetworkManager";
+constexpr const char* NM_PATH = "/org/freedesktop/NetworkManager";
+constexpr const char* NM_SETTINGS_PATH = "/org/freedesktop/NetworkManager/Settings";
+constexpr const char* NM_IFACE = "org.freedesktop.NetworkManager";
+constexpr const char* NM_DEVICE_IFACE = "org.freedesktop.NetworkManager.Device";
+constexpr const char* NM_WIRELESS_IFACE = "org.freedesktop.NetworkManager.Device.Wireless";
+constexpr const char* NM_AP_IFACE = "org.freedesktop.NetworkManager.AccessPoint";
+constexpr const char* NM_SETTINGS_IFACE = "org.freedesktop.NetworkManager.Settings";
+constexpr const char* NM_CONNECTION_IFACE = "org.freedesktop.NetworkManager.Settings.Connection";
+constexpr const char* NM_ACTIVE_IFACE = "org.freedesktop.NetworkManager.Connection.Active";
+constexpr const char* DBUS_PROPERTIES_IFACE = "org.freedesktop.DBus.Properties";
+
+constexpr uint NM_DEVICE_TYPE_WIFI = 2;
+
+constexpr uint NM_DEVICE_STATE_DISCONNECTED = 30;
+constexpr uint NM_DEVICE_STATE_PREPARE = 40;
+constexpr uint NM_DEVICE_STATE_CONFIG = 50;
+constexpr uint NM_DEVICE_STATE_NEED_AUTH = 60;
+constexpr uint NM_DEVICE_STATE_IP_CONFIG = 70;
+constexpr uint NM_DEVICE_STATE_ACTIVATED = 100;
+constexpr uint NM_DEVICE_STATE_FAILED = 120;
+constexpr uint NM_DEVICE_STATE_REASON_NO_SECRETS = 7;
+
+constexpr uint NM_STATE_DISCONNECTED = 20;
+constexpr uint NM_STATE_CONNECTED_GLOBAL = 70;
+constexpr uint NM_CONNECTIVITY_NONE = 1;
+constexpr uint NM_CONNECTIVITY_FULL = 4;
+
+constexpr uint NM_ACTIVE_CONNECTION_STATE_ACTIVATING = 1;
+constexpr uint NM_ACTIVE_CONNECTION_STATE_ACTIVATED = 2;
+constexpr uint NM_ACTIVE_CONNECTION_STATE_DEACTIVATED = 4;
+constexpr uint NM_ACTIVE_CONNECTION_STATE_REASON_USER_DISCONNECTED = 2;
+constexpr uint NM_ACTIVE_CONNECTION_STATE_REASON_NO_SECRETS = 9;
+
+constexpr uint NM_802_11_AP_FLAGS_PRIVACY = 0x1;
+// Pairwise and group CCMP with PSK key management, a WPA2 home network
+constexpr uint NM_802_11_AP_SEC_WPA2_PSK = 0x188;
+
+struct Options
+{
+    int devices = 1;
+    int accessPoints = 20;
+    int latencyMs = 0;
+    int scanMs = 2000;
+    int connectMs = 3000;
+    // Access points replaced by another one on every scan
+    int churn = 0;
+    // Empty accepts any password
+    QString password;
+    uint connectivity = NM_CONNECTIVITY_NONE;
+};
+
+class FakeNetworkManager : public QDBusVirtualObject
+{
+public:
+    FakeNetworkManager(const Options& options, const QDBusConnection& bus);
+
+    QString introspect(const QString& path) const override;
+    bool handleMessage(const QDBusMessage& message, const QDBusConnection& connection) override;
+
+    // Scripted transitions
+    bool runScript(const QString& fileName);
+    void setConnectivity(uint connectivity);
+    void setDeviceState(const QString& device, uint state, uint reason = 0);
+    void restart();
+
+private:
+    void dispatch(const QDBusMessage& message);
+    void setProperties(const QString& path, const QString& interface, const QVariantMap& changed);
+    void emitSignal(const QString& path, const QString& interface, const QString& name,
+                    const QVariantList& arguments);
+    void reply(const QDBusMessage& message, const QVariantList& arguments = {});
+    void replyError(const QDBusMessage& message, const QString& name, const QString& text);
+
+    QString addAccessPoint(const QString& device);
+    void removeAccessPoint(const QString& device, const QString& ap);
+    void finishScan(const QString& device);
+    void addConnection(const QDBusMessage& message);
+    void activate(const QDBusMessage& message, const QString& connection);
+    void completeActivation(const QString& active, const QString& psk);
+    void deactivate(const QString& active, uint reason);
+
+    Options m_options;
+    QDBusConnection m_bus;
+    // Object path -> interface -> properties
+    QHash<QString, QHash<QString, QVariantMap>> m_objects;
+    // Saved profiles, secrets included; they survive a restart
+    QMap<QString, NMVariantMapMap> m_connections;
+    QStringList m_devices;
+    QSet<QString> m_scanning;
+    int m_nextAccessPoint = 0;
+    int m_nextConnection = 0;
+};
+
+FakeNetworkManager::FakeNetworkManager(const Options& options, const QDBusConnection& bus)
+    : m_options(options)
+    , m_bus(bus)
+{
+    const uint connectivity = m_options.connectivity;
+    m_objects[NM_PATH][NM_IFACE] = {
+        { QStringLiteral("Version"), QStringLiteral("1.46.0") },
+        { QStringLiteral("Connectivity"), connectivity },
+        { QStringLiteral("State"), connectivity == NM_CONNECTIVITY_FULL ? NM_STATE_CONNECTED_GLOBAL
+                                                                         : NM_STATE_DISCONNECTED },
+        { QStringLiteral("PrimaryConnection"), QVariant::fromValue(QDBusObjectPath(QStringLiteral("/"))) },
+    };
+    m_objects[NM_SETTINGS_PATH][NM_SETTINGS_IFACE] = {};
+
+    for (int i = 0; i < m_options.devices; ++i)
+    {
+        const QString device = QStringLiteral("%1/Devices/%2").arg(QLatin1String(NM_PATH)).arg(i + 1);
+        m_devices << device;
+        m_objects[device][NM_DEVICE_IFACE] = {
+            { QStringLiteral("Interface"), QStringLiteral("wlan%1").arg(i) },
+            { QStringLiteral("DeviceType"), NM_DEVICE_TYPE_WIFI },
+            { QStringLiteral("State"), NM_DEVICE_STATE_DISCONNECTED },
+        };
+        m_objects[device][NM_WIRELESS_IFACE] = {
+            { QStringLiteral("LastScan"), QDateTime::currentMSecsSinceEpoch() },
+            { QStringLiteral("ActiveAccessPoint"), QVariant::fromValue(QDBusObjectPath(QStringLiteral("/"))) },
+        };
+        for (int j = 0; j < m_options.accessPoints; ++j)
+            addAccessPoint(device);
+    }
+}
+
+QString
+FakeNetworkManager::introspect(const QString& path) const
+{
+    // The page never introspects, and neither should anything timed here
+    Q_UNUSED(path)
+    return QString();
+}
+
+bool
+FakeNetworkManager::handleMessage(const QDBusMessage& message, const QDBusConnection& connection)
+{
+    Q_UNUSED(connection)
+    if (!m_objects.contains(message.path()))
+        return false;
+
+    // Every call costs the injected latency, like a busy daemon would
+    QTimer::singleShot(m_options.latencyMs, this, [this, message]() { dispatch(message); });
+    return true;
+}
+
+void
+FakeNetworkManager::dispatch(const QDBusMessage& message)
+{
+    const QString path = message.path();
+    const QString interface = message.interface();
+    const QString member = message.member();
+    const QVariantList args = message.arguments();
+
+    if (!m_objects.contains(path))
+    {
+        replyError(message, QStringLiteral("org.freedesktop.DBus.Error.UnknownObject"), path);
+        return;
+    }
+
+    if (interface == QLatin1String(DBUS_PROPERTIES_IFACE) && !args.isEmpty())
+    {
+        const QVariantMap properties = m_objects[path].value(args.at(0).toString());
+        if (member == QLatin1String("GetAll"))
+            reply(message, { properties });
+        else if (member == QLatin1String("Get") && args.size() > 1 && properties.contains(args.at(1).toString()))
+            reply(message, { QVariant::fromValue(QDBusVariant(properties.value(args.at(1).toString()))) });
+        else
+            replyError(message, QStringLiteral("org.freedesktop.DBus.Error.InvalidArgs"), member);
+        return;
+    }
+
+    if (path == QLatin1String(NM_PATH) && interface == QLatin1String(NM_IFACE))
+    {
+        if (member == QLatin1String("GetDevices"))
+        {
+            QList<QDBusObjectPath> devices;
+            for (const auto& device : std::as_const(m_devices))
+                devices << QDBusObjectPath(device);
+            reply(message, { QVariant::fromValue(devices) });
+            return;
+        }
+        if (member == QLatin1String("AddAndActivateConnection") && args.size() == 3)
+        {
+            addConnection(message);
+            return;
+        }
+        if (member == QLatin1String("ActivateConnection") && args.size() == 3)
+        {
+            const QString connection = args.at(0).value<QDBusObjectPath>().path();
+            if (!m_connections.contains(connection))
+                replyError(message, QStringLiteral("org.freedesktop.NetworkManager.UnknownConnection"), connection);
+            else
+                activate(message, connection);
+            return;
+        }
+        if (member == QLatin1String("DeactivateConnection") && args.size() == 1)
+        {
+            const QString active = args.at(0).value<QDBusObjectPath>().path();
+            if (!m_objects.contains(active))
+            {
+                replyError(message, QStringLiteral("org.freedesktop.NetworkManager.ConnectionNotActive"), active);
+                return;
+            }
+            deactivate(active, NM_ACTIVE_CONNECTION_STATE_REASON_USER_DISCONNECTED);
+            reply(message);
+            return;
+        }
+    }
+
+    if (path == QLatin1String(NM_SETTINGS_PATH) && interface == QLatin1String(NM_SETTINGS_IFACE)
+        && member == QLatin1String("ListConnections"))
+    {
+        QList<QDBusObjectPath> connections;
+        for (auto it = m_connections.constBegin(); it != m_connections.constEnd(); ++it)
+            connections << QDBusObjectPath(it.key());
+        reply(message, { QVariant::fromValue(connections) });
+        return;
+    }
+
+    if (interface == QLatin1String(NM_CONNECTION_IFACE) && m_connections.contains(path))
+    {
+        NMVariantMapMap& settings = m_connections[path];
+        if (member == QLatin1String("GetSettings"))
+        {
+            // Without secrets, as from the real one
+            NMVariantMapMap visible = settings;
+            const QString security = QStringLiteral("802-11-wireless-security");
+            if (visible.contains(security))
+                visible[security].remove(QStringLiteral("psk"));
+            reply(message, { QVariant::fromValue(visible) });
+            return;
+        }
+        if (member == QLatin1String("GetSecrets") && args.size() == 1)
+        {
+            const QString name = args.at(0).toString();
+            NMVariantMapMap secrets;
+            if (settings.value(name).contains(QStringLiteral("psk")))
+                secrets[name] = { { QStringLiteral("psk"), settings.value(name).value(QStringLiteral("psk")) } };
+            reply(message, { QVariant::fromValue(secrets) });
+            return;
+        }
+        if (member == QLatin1String("Update") && args.size() == 1)
+        {
+            settings = qdbus_cast<NMVariantMapMap>(args.at(0));
+            reply(message);
+            return;
+        }
+    }
+
+    if (interface == QLatin1String(NM_WIRELESS_IFACE) && m_devices.contains(path))
+    {
+        if (member == QLatin1String("GetAccessPoints"))
+        {
+            QList<QDBusObjectPath> accessPoints;
+            for (const auto& ap : m_objects[path][NM_WIRELESS_IFACE].value(QStringLiteral("AccessPoints"))
+                                      .value<QList<QDBusObjectPath>>())
+                accessPoints << ap;
+            reply(message, { QVariant::fromValue(accessPoints) });
+            return;
+        }
+        if (member == QLatin1String("RequestScan"))
+        {
+            reply(message);
+            // Requests while a scan runs are answered by that scan
+            if (!m_scanning.contains(path))
+            {
+                m_scanning.insert(path);
+                QTimer::singleShot(m_options.scanMs, this, [this, path]() { finishScan(path); });
+            }
+            return;
+        }
+    }
+
+    replyError(message, QStringLiteral("org.freedesktop.DBus.Error.UnknownMethod"),
+               QStringLiteral("%1.%2").arg(interface, member));
+}
+
+void
+FakeNetworkManager::setProperties(const QString& path, const QString& interface, const QVariantMap& changed)
+{
+    QVariantMap& properties = m_objects[path][interface];
+    for (auto it = changed.constBegin(); it != changed.constEnd(); ++it)
+        properties.insert(it.key(), it.value());
+    emitSignal(path, DBUS_PROPERTIES_IFACE, QStringLiteral("PropertiesChanged"),
+               { interface, changed, QStringList() });
+}
+
+void
+FakeNetworkManager::emitSignal(const QString& path, const QString& interface, const QString& name,
+                               const QVariantList& arguments)
+{
+    QDBusMessage signal = QDBusMessage::createSignal(path, interface, name);
+    signal.setArguments(arguments);
+    m_bus.send(signal);
+}
+
+void
+FakeNetworkManager::reply(const QDBusMessage& message, const QVariantList& arguments)
+{
+    m_bus.send(message.createReply(arguments));
+}
+
+void
+FakeNetworkManager::replyError(const QDBusMessage& message, const QString& name, const QString& text)
+{
+    m_bus.send(message.createErrorReply(name, text));
+}
+
+QString
+FakeNetworkManager::addAccessPoint(const QString& device)
+{
+    // The same names on every device, as with two radios in one room
+    const int index = m_nextAccessPoint++;
+    const int network = index % std::max(m_options.accessPoints, 1);
+    const bool secured = network % 3 != 0;
+    const QString ap = QStringLiteral("%1/AccessPoint/%2").arg(QLatin1String(NM_PATH)).arg(index + 1);
+    m_objects[ap][NM_AP_IFACE] = {
+        { QStringLiteral("Ssid"), QStringLiteral("Network %1").arg(network + 1).toUtf8() },
+        { QStringLiteral("Strength"), QVariant::fromValue(uchar(QRandomGenerator::global()->bounded(10, 100))) },
+        { QStringLiteral("Flags"), secured ? NM_802_11_AP_FLAGS_PRIVACY : 0u },
+        { QStringLiteral("WpaFlags"), 0u },
+        { QStringLiteral("RsnFlags"), secured ? NM_802_11_AP_SEC_WPA2_PSK : 0u },
+    };
+
+    QVariantMap& wireless = m_objects[device][NM_WIRELESS_IFACE];
+    auto accessPoints = wireless.value(QStringLiteral("AccessPoints")).value<QList<QDBusObjectPath>>();
+    accessPoints << QDBusObjectPath(ap);
+    wireless.insert(QStringLiteral("AccessPoints"), QVariant::fromValue(accessPoints));
+    return ap;
+}
+
+void
+FakeNetworkManager::removeAccessPoint(const QString& device, const QString& ap)
+{
+    QVariantMap& wireless = m_objects[device][NM_WIRELESS_IFACE];
+    auto accessPoints = wireless.value(QStringLiteral("AccessPoints")).value<QList<QDBusObjectPath>>();
+    accessPoints.removeAll(QDBusObjectPath(ap));
+    wireless.insert(QStringLiteral("AccessPoints"), QVariant::fromValue(accessPoints));
+    m_objects.remove(ap);
+    emitSignal(device, NM_WIRELESS_IFACE, QStringLiteral("AccessPointRemoved"),
+               { QVariant::fromValue(QDBusObjectPath(ap)) });
+}
+
+void
+FakeNetworkManager::finishScan(const QString& device)
+{
+    m_scanning.remove(device);
+
+    const auto accessPoints = m_objects[device][NM_WIRELESS_IFACE].value(QStringLiteral("AccessPoints"))
+                                  .value<QList<QDBusObjectPath>>();
+    const QString active = m_objects[device][NM_WIRELESS_IFACE].value(QStringLiteral("ActiveAccessPoint"))
+                               .value<QDBusObjectPath>().path();
+    int churn = m_options.churn;
+    for (const auto& ap : accessPoints)
+    {
+        if (churn > 0 && ap.path() != active)
+        {
+            --churn;
+            removeAccessPoint(device, ap.path());
+            const QString added = addAccessPoint(device);
+            emitSignal(device, NM_WIRELESS_IFACE, QStringLiteral("AccessPointAdded"),
+                       { QVariant::fromValue(QDBusObjectPath(added)) });
+            continue;
+        }
+
+        // Signal strength wanders a little between scans
+        const int strength = m_objects[ap.path()][NM_AP_IFACE].value(QStringLiteral("Strength")).toInt();
+        const int moved = std::clamp(strength + QRandomGenerator::global()->bounded(-5, 6), 0, 100);
+        if (moved != strength)
+            setProperties(ap.path(), NM_AP_IFACE, { { QStringLiteral("Strength"), QVariant::fromValue(uchar(moved)) } });
+    }
+
+    setProperties(device, NM_WIRELESS_IFACE,
+                  { { QStringLiteral("LastScan"), QDateTime::currentMSecsSinceEpoch() } });
+}
+
+void
+FakeNetworkManager::addConnection(const QDBusMessage& message)
+{
+    auto settings = qdbus_cast<NMVariantMapMap>(message.arguments().at(0));
+    settings[QStringLiteral("connection")].insert(QStringLiteral("uuid"),
+                                                  QUuid::createUuid().toString(QUuid::WithoutBraces));
+
+    // Saved before activating, and kept if that fails, like NetworkManager
+    // does; repeated calls pile up profiles
+    const QString connection
+        = QStringLiteral("%1/%2").arg(QLatin1String(NM_SETTINGS_PATH)).arg(m_connections.size() + 1);
+    m_connections.insert(connection, settings);
+    m_objects[connection][NM_CONNECTION_IFACE] = {};
+    activate(message, connection);
+}
+
+void
+FakeNetworkManager::activate(const QDBusMessage& message, const QString& connection)
+{
+    const QVariantList args = message.arguments();
+    NMVariantMapMap& settings = m_connections[connection];
+    const QString device = args.at(1).value<QDBusObjectPath>().path();
+    QString ap = args.at(2).value<QDBusObjectPath>().path();
+    if (!m_devices.contains(device))
+    {
+        replyError(message, QStringLiteral("org.freedesktop.NetworkManager.UnknownDevice"), device);
+        return;
+    }
+
+    // "/" asks for the strongest access point with the SSID
+    const QByteArray ssid = settings.value(QStringLiteral("802-11-wireless")).value(QStringLiteral("ssid")).toByteArray();
+    if (ap == QLatin1String("/"))
+    {
+        int best = -1;
+        const auto accessPoints = m_objects[device][NM_WIRELESS_IFACE].value(QStringLiteral("AccessPoints"))
+                                      .value<QList<QDBusObjectPath>>();
+        for (const auto& candidate : accessPoints)
+        {
+            const QVariantMap& properties = m_objects[candidate.path()][NM_AP_IFACE];
+            const int strength = properties.value(QStringLiteral("Strength")).toInt();
+            if (properties.value(QStringLiteral("Ssid")).toByteArray() == ssid && strength > best)
+            {
+                best = strength;
+                ap = candidate.path();
+            }
+        }
+    }
+    if (!m_objects.contains(ap))
+    {
+        replyError(message, QStringLiteral("org.freedesktop.NetworkManager.UnknownConnection"),
+                   QStringLiteral("No network with SSID '%1' found").arg(QString::fromUtf8(ssid)));
+        return;
+    }
+
+    // One connection per device, as in NetworkManager
+    for (auto it = m_objects.constBegin(); it != m_objects.constEnd(); ++it)
+    {
+        const QVariantMap& other = it.value().value(NM_ACTIVE_IFACE);
+        if (!other.isEmpty()
+            && other.value(QStringLiteral("Devices")).value<QList<QDBusObjectPath>>().contains(QDBusObjectPath(device)))
+        {
+            deactivate(it.key(), NM_ACTIVE_CONNECTION_STATE_REASON_USER_DISCONNECTED);
+            break;
+        }
+    }
+
+    settings[QStringLiteral("connection")].insert(QStringLiteral("timestamp"),
+                                                  qulonglong(QDateTime::currentSecsSinceEpoch()));
+    const int index = ++m_nextConnection;
+    const QString active = QStringLiteral("%1/ActiveConnection/%2").arg(QLatin1String(NM_PATH)).arg(index);
+    m_objects[active][NM_ACTIVE_IFACE] = {
+        { QStringLiteral("Id"), settings.value(QStringLiteral("connection")).value(QStringLiteral("id")) },
+        { QStringLiteral("State"), NM_ACTIVE_CONNECTION_STATE_ACTIVATING },
+        { QStringLiteral("Devices"), QVariant::fromValue(QList<QDBusObjectPath> { QDBusObjectPath(device) }) },
+        { QStringLiteral("SpecificObject"), QVariant::fromValue(QDBusObjectPath(ap)) },
+    };
+    if (message.member() == QLatin1String("AddAndActivateConnection"))
+        reply(message, { QVariant::fromValue(QDBusObjectPath(connection)), QVariant::fromValue(QDBusObjectPath(active)) });
+    else
+        reply(message, { QVariant::fromValue(QDBusObjectPath(active)) });
+
+    // The device walks through its states over connectMs
+    const uint states[] = { NM_DEVICE_STATE_PREPARE, NM_DEVICE_STATE_CONFIG, NM_DEVICE_STATE_NEED_AUTH,
+                            NM_DEVICE_STATE_IP_CONFIG };
+    const int step = m_options.connectMs / 5;
+    for (int i = 0; i < 4; ++i)
+    {
+        QTimer::singleShot(step * (i + 1), this, [this, active, device, state = states[i]]() {
+            if (m_objects.contains(active))
+                setDeviceState(device, state);
+        });
+    }
+    const QString psk = settings.value(QStringLiteral("802-11-wireless-security")).value(QStringLiteral("psk")).toString();
+    QTimer::singleShot(m_options.connectMs, this, [this, active, psk]() {
+        if (m_objects.contains(active))
+            completeActivation(active, psk);
+    });
+}
+
+void
+FakeNetworkManager::completeActivation(const QString& active, const QString& psk)
+{
+    const QVariantMap connection = m_objects[active][NM_ACTIVE_IFACE];
+    const QString device = connection.value(QStringLiteral("Devices")).value<QList<QDBusObjectPath>>().value(0).path();
+    const QString ap = connection.value(QStringLiteral("SpecificObject")).value<QDBusObjectPath>().path();
+    const bool secured = m_objects[ap][NM_AP_IFACE].value(QStringLiteral("RsnFlags")).toUInt() != 0;
+
+    if (secured && !m_options.password.isEmpty() && psk != m_options.password)
+    {
+        setDeviceState(device, NM_DEVICE_STATE_FAILED, NM_DEVICE_STATE_REASON_NO_SECRETS);
+        deactivate(active, NM_ACTIVE_CONNECTION_STATE_REASON_NO_SECRETS);
+        return;
+    }
+
+    setProperties(device, NM_WIRELESS_IFACE,
+                  { { QStringLiteral("ActiveAccessPoint"), QVariant::fromValue(QDBusObjectPath(ap)) } });
+    setDeviceState(device, NM_DEVICE_STATE_ACTIVATED);
+    setProperties(active, NM_ACTIVE_IFACE, { { QStringLiteral("State"), NM_ACTIVE_CONNECTION_STATE_ACTIVATED } });
+    emitSignal(active, NM_ACTIVE_IFACE, QStringLiteral("StateChanged"), { NM_ACTIVE_CONNECTION_STATE_ACTIVATED, 0u });
+    setProperties(NM_PATH, NM_IFACE,
+                  { { QStringLiteral("PrimaryConnection"), QVariant::fromValue(QDBusObjectPath(active)) } });
+    setConnectivity(NM_CONNECTIVITY_FULL);
+}
+
+void
+FakeNetworkManager::deactivate(const QString& active, uint reason)
+{
+    const QVariantMap connection = m_objects[active][NM_ACTIVE_IFACE];
+    const QString device = connection.value(QStringLiteral("Devices")).value<QList<QDBusObjectPath>>().value(0).path();
+
+    setProperties(active, NM_ACTIVE_IFACE, { { QStringLiteral("State"), NM_ACTIVE_CONNECTION_STATE_DEACTIVATED } });
+    emitSignal(active, NM_ACTIVE_IFACE, QStringLiteral("StateChanged"), { NM_ACTIVE_CONNECTION_STATE_DEACTIVATED, reason });
+    m_objects.remove(active);
+
+    if (m_devices.contains(device))
+    {
+        setProperties(device, NM_WIRELESS_IFACE,
+                      { { QStringLiteral("ActiveAccessPoint"), QVariant::fromValue(QDBusObjectPath(QStringLiteral("/"))) } });
+        setDeviceState(device, NM_DEVICE_STATE_DISCONNECTED);
+    }
+    if (m_objects[NM_PATH][NM_IFACE].value(QStringLiteral("PrimaryConnection")).value<QDBusObjectPath>().path() == active)
+    {
+        setProperties(NM_PATH, NM_IFACE,
+                      { { QStringLiteral("PrimaryConnection"), QVariant::fromValue(QDBusObjectPath(QStringLiteral("/"))) } });
+        setConnectivity(NM_CONNECTIVITY_NONE);
+    }
+}
+
+void
+FakeNetworkManager::setConnectivity(uint connectivity)
+{
+    const uint state = connectivity == NM_CONNECTIVITY_FULL ? NM_STATE_CONNECTED_GLOBAL : NM_STATE_DISCONNECTED;
+    const uint oldState = m_objects[NM_PATH][NM_IFACE].value(QStringLiteral("State")).toUInt();
+    setProperties(NM_PATH, NM_IFACE, { { QStringLiteral("Connectivity"), connectivity },
+                                       { QStringLiteral("State"), state } });
+    if (state != oldState)
+        emitSignal(NM_PATH, NM_IFACE, QStringLiteral("StateChanged"), { state });
+}
+
+void
+FakeNetworkManager::setDeviceState(const QString& device, uint state, uint reason)
+{
+    const uint oldState = m_objects[device][NM_DEVICE_IFACE].value(QStringLiteral("State")).toUInt();
+    setProperties(device, NM_DEVICE_IFACE, { { QStringLiteral("State"), state } });
+    emitSignal(device, NM_DEVICE_IFACE, QStringLiteral("StateChanged"), { state, oldState, reason });
+}
+
+void
+FakeNetworkManager::restart()
+{
+    // Clients see the name go away and come back, as after a crash
+    m_bus.unregisterService(NM_SERVICE);
+    QTimer::singleShot(1000, this, [this]() { m_bus.registerService(NM_SERVICE); });
+}
+
+bool
+FakeNetworkManager::runScript(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        std::fprintf(stderr, "fake-networkmanager: cannot read %s\n", qPrintable(fileName));
+        return false;
+    }
+
+    // <ms> connectivity <n> | <ms> device <index> <state> [reason] | <ms> restart
+    QTextStream in(&file);
+    int lineNumber = 0;
+    while (!in.atEnd())
+    {
+        ++lineNumber;
+        const QString line = in.readLine().section(QLatin1Char('#'), 0, 0).trimmed();
+        if (line.isEmpty())
+            continue;
+        const QStringList words = line.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+        const int at = words.value(0).toInt();
+        const QString what = words.value(1);
+        if (what == QLatin1String("connectivity") && words.size() == 3)
+        {
+            const uint connectivity = words.at(2).toUInt();
+            QTimer::singleShot(at, this, [this, connectivity]() { setConnectivity(connectivity); });
+        }
+        else if (what == QLatin1String("device") && words.size() >= 4 && words.at(2).toInt() < m_devices.size())
+        {
+            const QString device = m_devices.at(words.at(2).toInt());
+            const uint state = words.at(3).toUInt();
+            const uint reason = words.value(4).toUInt();
+            QTimer::singleShot(at, this, [this, device, state, reason]() { setDeviceState(device, state, reason); });
+        }
+        else if (what == QLatin1String("restart") && words.size() == 2)
+        {
+            QTimer::singleShot(at, this, [this]() { restart(); });
+        }
+        else
+        {
+            std::fprintf(stderr, "fake-networkmanager: %s:%d: cannot parse '%s'\n", qPrintable(fileName),
+                         lineNumber, qPrintable(line));
+            return false;
+        }
+    }
+    return true;
+}
+
+int
+main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Fake NetworkManager for exercising the networksetup page"));
+    parser.addHelpOption();
+    const QCommandLineOption devicesOption(QStringLiteral("devices"), QStringLiteral("WiFi devices"),
+                                           QStringLiteral("n"), QStringLiteral("1"));
+    const QCommandLineOption accessPointsOption(QStringLiteral("access-points"),
+                                                QStringLiteral("Access points per device"), QStringLiteral("n"),
+                                                QStringLiteral("20"));
+    const QCommandLineOption latencyOption(QStringLiteral("latency"), QStringLiteral("Delay before every reply"),
+                                           QStringLiteral("ms"), QStringLiteral("0"));
+    const QCommandLineOption scanOption(QStringLiteral("scan-time"), QStringLiteral("How long a scan takes"),
+                                        QStringLiteral("ms"), QStringLiteral("2000"));
+    const QCommandLineOption connectOption(QStringLiteral("connect-time"),
+                                           QStringLiteral("How long activating a connection takes"),
+                                           QStringLiteral("ms"), QStringLiteral("3000"));
+    const QCommandLineOption churnOption(QStringLiteral("churn"),
+                                         QStringLiteral("Access points replaced by new ones on every scan"),
+                                         QStringLiteral("n"), QStringLiteral("0"));
+    const QCommandLineOption passwordOption(QStringLiteral("password"),
+                                            QStringLiteral("The only password secured networks accept"),
+                                            QStringLiteral("psk"));
+    const QCommandLineOption connectivityOption(QStringLiteral("connectivity"),
+                                                QStringLiteral("Connectivity at start, 1 (none) to 4 (full)"),
+                                                QStringLiteral("n"), QStringLiteral("1"));
+    const QCommandLineOption scriptOption(QStringLiteral("script"), QStringLiteral("Timed transitions to play"),
+                                          QStringLiteral("file"));
+    parser.addOptions({ devicesOption, accessPointsOption, latencyOption, scanOption, connectOption, churnOption,
+                        passwordOption, connectivityOption, scriptOption });
+    parser.process(app);
+
+    // Never claim the name on the real system bus
+    if (qEnvironmentVariableIsEmpty("DBUS_SYSTEM_BUS_ADDRESS"))
+    {
+        std::fprintf(stderr, "fake-networkmanager: DBUS_SYSTEM_BUS_ADDRESS must name a private bus\n");
+        return 1;
+    }
+
+    Options options;
+    options.devices = parser.value(devicesOption).toInt();
+    options.accessPoints = parser.value(accessPointsOption).toInt();
+    options.latencyMs = parser.value(latencyOption).toInt();
+    options.scanMs = parser.value(scanOption).toInt();
+    options.connectMs = parser.value(connectOption).toInt();
+    options.churn = parser.value(churnOption).toInt();
+    options.password = parser.value(passwordOption);
+    options.connectivity = parser.value(connectivityOption).toUInt();
+
+    qDBusRegisterMetaType<QList<QDBusObjectPath>>();
+    qDBusRegisterMetaType<NMVariantMapMap>();
+
+    QDBusConnection bus = QDBusConnection::systemBus();
+    if (!bus.isConnected())
+    {
+        std::fprintf(stderr, "fake-networkmanager: cannot connect to the bus\n");
+        return 1;
+    }
+
+    FakeNetworkManager nm(options, bus);
+    if (parser.isSet(scriptOption) && !nm.runScript(parser.value(scriptOption)))
+        return 1;
+    if (!bus.registerVirtualObject(NM_PATH, &nm, QDBusConnection::SubPath) || !bus.registerService(NM_SERVICE))
+    {
+        std::fprintf(stderr, "fake-networkmanager: %s\n", qPrintable(bus.lastError().message()));
+        return 1;
+    }
+
+    return app.exec();
+}
@@ -0,0 +1,160 @@
+/* SPDX-FileCopyrightText: no
+ * SPDX-License-Identifier: CC0-1.0
+ *
+ * Times the networksetup page against fake-networkmanager on a private
+ * bus, for a growing number of access points: how long the constructor
+ * blocks, how long until every network is in the list, and how often
+ * the event loop stood still meanwhile.
+ *
+ *   make bench && QT_QPA_PLATFORM=offscreen bench/network-setup-bench
+ *
+ * FAKE_NM names another fake-networkmanager binary.
+ */
+
+#include "NetworkSetupPage.h"
+
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QElapsedTimer>
+#include <QListWidget>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QtTest>
+
+#include <algorithm>
+#include <memory>
+
+// The stall watcher's tick and what counts as a stall, as SetupTrace uses
+constexpr int TICK_MS = 20;
+constexpr int STALL_MS = 100;
+
+// Long enough for a thousand networks on a slow machine
+constexpr int POPULATE_TIMEOUT_MS = 60000;
+
+class NetworkSetupBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void populate_data();
+    void populate();
+    void cleanup();
+
+private:
+    bool nameOwned() const;
+
+    QTemporaryDir m_busDir;
+    QProcess m_bus;
+    QProcess m_fake;
+};
+
+void
+NetworkSetupBench::initTestCase()
+{
+    QVERIFY(m_busDir.isValid());
+
+    // Has to be in place before anything asks for the system bus
+    const QString address = QStringLiteral("unix:path=%1/bus").arg(m_busDir.path());
+    m_bus.start(QStringLiteral("dbus-daemon"),
+                { QStringLiteral("--session"), QStringLiteral("--nofork"), QStringLiteral("--print-address"),
+                  QStringLiteral("--address=%1").arg(address) });
+    QVERIFY2(m_bus.waitForStarted(), "dbus-daemon did not start");
+    QVERIFY2(m_bus.waitForReadyRead(5000), "dbus-daemon did not come up");
+    qputenv("DBUS_SYSTEM_BUS_ADDRESS", address.toUtf8());
+
+    QVERIFY(QDBusConnection::systemBus().isConnected());
+}
+
+void
+NetworkSetupBench::cleanupTestCase()
+{
+    m_bus.terminate();
+    m_bus.waitForFinished(5000);
+}
+
+void
+NetworkSetupBench::populate_data()
+{
+    QTest::addColumn<int>("accessPoints");
+
+    for (int count : { 10, 50, 100, 250, 500, 1000 })
+        QTest::addRow("%d APs", count) << count;
+}
+
+void
+NetworkSetupBench::populate()
+{
+    QFETCH(int, accessPoints);
+
+    const QString fake = qEnvironmentVariableIsEmpty("FAKE_NM")
+        ? QCoreApplication::applicationDirPath() + QStringLiteral("/../fake-networkmanager")
+        : qEnvironmentVariable("FAKE_NM");
+    // Scans answer at once, so the latency is the page's own
+    m_fake.start(fake, { QStringLiteral("--access-points"), QString::number(accessPoints),
+                         QStringLiteral("--scan-time"), QStringLiteral("0") });
+    QVERIFY2(m_fake.waitForStarted(), qPrintable(fake + QStringLiteral(" did not start")));
+    QTRY_VERIFY_WITH_TIMEOUT(nameOwned(), 5000);
+
+    int stalls = 0;
+    qint64 longestStall = 0;
+    QElapsedTimer clock;
+    QTimer watcher;
+    watcher.setTimerType(Qt::PreciseTimer);
+    connect(&watcher, &QTimer::timeout, this, [&, last = qint64(0)]() mutable {
+        const qint64 tick = clock.elapsed();
+        const qint64 late = tick - last - TICK_MS;
+        if (late >= STALL_MS)
+        {
+            ++stalls;
+            longestStall = std::max(longestStall, late);
+        }
+        last = tick;
+    });
+
+    clock.start();
+    watcher.start(TICK_MS);
+
+    std::unique_ptr<NetworkSetupPage> page(new NetworkSetupPage());
+    const qint64 constructed = clock.elapsed();
+    page->show();
+
+    auto* list = page->findChild<QListWidget*>();
+    QVERIFY(list);
+    QTRY_COMPARE_WITH_TIMEOUT(list->count(), accessPoints, POPULATE_TIMEOUT_MS);
+    const qint64 populated = clock.elapsed() - constructed;
+    watcher.stop();
+
+    qInfo().noquote() << QStringLiteral("%1 APs: constructor %2 ms, scan to full list %3 ms, "
+                                        "%4 stalls of %5 ms or more, longest %6 ms")
+                             .arg(accessPoints)
+                             .arg(constructed)
+                             .arg(populated)
+                             .arg(stalls)
+                             .arg(STALL_MS)
+                             .arg(longestStall);
+    QTest::setBenchmarkResult(qreal(populated), QTest::WalltimeMilliseconds);
+}
+
+void
+NetworkSetupBench::cleanup()
+{
+    // A fresh fake per row; wait for its name to go so the next page
+    // does not find the old one
+    m_fake.terminate();
+    m_fake.waitForFinished(5000);
+    QTRY_VERIFY_WITH_TIMEOUT(!nameOwned(), 5000);
+}
+
+bool
+NetworkSetupBench::nameOwned() const
+{
+    return QDBusConnection::systemBus().interface()->isServiceRegistered(
+        QStringLiteral("org.freedesktop.NetworkManager"));
+}
+
+QTEST_MAIN(NetworkSetupBench)
+
+#include "NetworkSetupBench.moc"
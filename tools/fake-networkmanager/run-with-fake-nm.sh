@@ -0,0 +1,56 @@
+#!/usr/bin/sh
+# SPDX-License-Identifier: MIT
+#
+# Run a command against the fake NetworkManager on a private bus
+#
+#   run-with-fake-nm.sh [fake-networkmanager options] -- command [args]
+#
+# The command sees the private bus as its system bus, so e.g.
+#
+#   ASAHI_SETUP_TRACE=/tmp/trace.json run-with-fake-nm.sh \
+#       --access-points 1000 --latency 20 -- calamares -d
+#
+# runs the installer against 1000 networks answering after 20 ms each.
+# With ASAHI_SETUP_TRACE set (the file has to exist, holding "[\n"),
+# the networksetup-page, wifi-scan, wifi-connect and event-loop-stall
+# phases in the trace show how long the network page took and how long
+# the GUI stood still. The stall watcher is only on where
+# ASAHI_SETUP_TRACE_STALLS is set, which this script does.
+
+HERE="$(dirname "$(readlink -f "$0")")"
+FAKE_NM="${FAKE_NM:-$HERE/fake-networkmanager}"
+
+NM_ARGS=""
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+    NM_ARGS="$NM_ARGS $1"
+    shift
+done
+[ "$1" = "--" ] && shift
+if [ $# -eq 0 ]; then
+    echo "usage: $0 [fake-networkmanager options] -- command [args]" >&2
+    exit 2
+fi
+
+BUS_DIR="$(mktemp -d)"
+dbus-daemon --session --fork --address="unix:path=$BUS_DIR/bus" --print-pid=3 3>"$BUS_DIR/pid" || exit 1
+export DBUS_SYSTEM_BUS_ADDRESS="unix:path=$BUS_DIR/bus"
+export ASAHI_SETUP_TRACE_STALLS="${ASAHI_SETUP_TRACE_STALLS:-1}"
+
+# shellcheck disable=SC2086
+"$FAKE_NM" $NM_ARGS &
+NM_PID=$!
+trap 'kill $NM_PID "$(cat "$BUS_DIR/pid")" 2>/dev/null; rm -rf "$BUS_DIR"' EXIT INT TERM
+
+# Wait for the name, so the command does not start without NetworkManager
+TRIES=50
+until dbus-send --bus="$DBUS_SYSTEM_BUS_ADDRESS" --print-reply --dest=org.freedesktop.DBus / \
+        org.freedesktop.DBus.NameHasOwner string:org.freedesktop.NetworkManager 2>/dev/null | grep -q true; do
+    TRIES=$((TRIES - 1))
+    if [ $TRIES -eq 0 ] || ! kill -0 $NM_PID 2>/dev/null; then
+        echo "$0: fake NetworkManager did not start" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+"$@"